@@ -0,0 +1,197 @@
+#pragma once
+
+#include "Entity.h"
+#include "ComponentType.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+constexpr size_t ARCHETYPE_CHUNK_SIZE = 16 * 1024;
+
+// Блок памяти фиксированного размера; внутри - колонки (SoA): сначала дескрипторы, затем каждый компонент.
+// Такты изменений ведутся на колонку чанка целиком, чтобы фильтр мог пропустить чанк без обхода строк
+struct alignas(64) ArchetypeChunk {
+    std::byte data[ARCHETYPE_CHUNK_SIZE];
+    std::array<std::atomic<uint32_t>, MAX_COMPONENTS> addedTicks;
+    std::array<std::atomic<uint32_t>, MAX_COMPONENTS> changedTicks;
+};
+
+struct ArchetypeColumn {
+    ComponentTypeID type;
+    size_t size;
+    size_t align;
+    size_t offset;
+};
+
+// Хранилище сущностей с одинаковым набором компонентов. Строки плотно упакованы:
+// все чанки, кроме последнего, заполнены, поэтому обход идёт по памяти подряд
+class Archetype {
+public:
+    static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+    template<typename... Ts>
+    static std::unique_ptr<Archetype> create() {
+        static_assert((std::is_trivially_copyable_v<Ts> && ...), "Archetype components must be trivially copyable");
+        return std::make_unique<Archetype>(std::vector<ArchetypeColumn>{ { componentTypeId<Ts>(), sizeof(Ts), alignof(Ts), 0 }... });
+    }
+
+    explicit Archetype(std::vector<ArchetypeColumn> columnsDesc) : columns(std::move(columnsDesc)) {
+        columnOf.fill(-1);
+        size_t rowSize = sizeof(EntityID);
+        for (size_t i = 0; i < columns.size(); ++i) {
+            columnOf[columns[i].type] = static_cast<int8_t>(i);
+            mask |= ComponentMask(1) << columns[i].type;
+            rowSize += columns[i].size;
+        }
+
+        // Подбираем вместимость так, чтобы колонки с выравниванием поместились в чанк
+        capacity = ARCHETYPE_CHUNK_SIZE / rowSize;
+        for (; capacity > 0; --capacity) {
+            size_t offset = capacity * sizeof(EntityID);
+            for (auto& column : columns) {
+                offset = (offset + column.align - 1) / column.align * column.align;
+                column.offset = offset;
+                offset += column.size * capacity;
+            }
+            if (offset <= ARCHETYPE_CHUNK_SIZE) break;
+        }
+        assert(capacity > 0 && "Archetype row does not fit into a chunk");
+    }
+
+    ComponentMask getMask() const { return mask; }
+    size_t size() const { return count; }
+    size_t chunkCapacity() const { return capacity; }
+    size_t chunkCount() const { return (count + capacity - 1) / capacity; }
+
+    size_t chunkSize(size_t chunk) const {
+        size_t begin = chunk * capacity;
+        return std::min(capacity, count - begin);
+    }
+
+    bool contains(EntityID entity) const {
+        uint32_t slot = entityIndex(entity);
+        return slot < sparse.size() && sparse[slot] != npos && entityAt(sparse[slot]) == entity;
+    }
+
+    // Новая строка в конце; колонки и их такты заполняет вызывающий через component() и raiseTicks()
+    void insert(EntityID entity) {
+        assert(!contains(entity));
+        if (count == chunks.size() * capacity) {
+            chunks.push_back(std::make_unique<ArchetypeChunk>());
+        }
+        uint32_t slot = entityIndex(entity);
+        if (slot >= sparse.size()) {
+            sparse.resize(static_cast<size_t>(slot) + 1, npos);
+        }
+        sparse[slot] = static_cast<uint32_t>(count);
+        entityAt(count) = entity;
+        ++count;
+    }
+
+    // swap-and-pop: последняя строка копируется на место удалённой во всех колонках
+    void remove(EntityID entity) {
+        if (!contains(entity)) return;
+        size_t row = sparse[entityIndex(entity)];
+        size_t last = count - 1;
+        if (row != last) {
+            EntityID moved = entityAt(last);
+            entityAt(row) = moved;
+            for (const auto& column : columns) {
+                std::memcpy(cell(column, row), cell(column, last), column.size);
+            }
+            // Строка сменила чанк: его такты не должны оказаться старше её собственных
+            ArchetypeChunk& from = *chunks[last / capacity];
+            ArchetypeChunk& to = *chunks[row / capacity];
+            for (size_t column = 0; column < columns.size(); ++column) {
+                raiseTick(to.addedTicks[column], from.addedTicks[column].load(std::memory_order_relaxed));
+                raiseTick(to.changedTicks[column], from.changedTicks[column].load(std::memory_order_relaxed));
+            }
+            sparse[entityIndex(moved)] = static_cast<uint32_t>(row);
+        }
+        sparse[entityIndex(entity)] = npos;
+        --count;
+    }
+
+    bool owns(ComponentTypeID type) const { return columnOf[type] >= 0; }
+
+    void* component(ComponentTypeID type, EntityID entity) {
+        assert(contains(entity) && owns(type));
+        return cell(columns[columnOf[type]], sparse[entityIndex(entity)]);
+    }
+
+    template<typename T>
+    T& get(EntityID entity) {
+        return *static_cast<T*>(component(componentTypeId<T>(), entity));
+    }
+
+    template<typename T>
+    const T& get(EntityID entity) const {
+        return *static_cast<const T*>(const_cast<Archetype*>(this)->component(componentTypeId<T>(), entity));
+    }
+
+    size_t chunkOf(EntityID entity) const {
+        assert(contains(entity));
+        return sparse[entityIndex(entity)] / capacity;
+    }
+
+    uint32_t addedTick(size_t chunk, ComponentTypeID type) const {
+        return chunks[chunk]->addedTicks[columnOf[type]].load(std::memory_order_relaxed);
+    }
+
+    uint32_t changedTick(size_t chunk, ComponentTypeID type) const {
+        return chunks[chunk]->changedTicks[columnOf[type]].load(std::memory_order_relaxed);
+    }
+
+    // Такты чанка - верхняя граница тактов его строк, поэтому пришедшая строка их только поднимает
+    void raiseTicks(size_t chunk, ComponentTypeID type, uint32_t added, uint32_t changed) {
+        raiseTick(chunks[chunk]->addedTicks[columnOf[type]], added);
+        raiseTick(chunks[chunk]->changedTicks[columnOf[type]], changed);
+    }
+
+    // Выборки из разных потоков пишут в один чанк одинаковый такт кадра
+    void markChanged(size_t chunk, ComponentTypeID type, uint32_t tick) {
+        chunks[chunk]->changedTicks[columnOf[type]].store(tick, std::memory_order_relaxed);
+    }
+
+    const EntityID* entities(size_t chunk) const {
+        return reinterpret_cast<const EntityID*>(chunks[chunk]->data);
+    }
+
+    template<typename T>
+    T* column(size_t chunk) {
+        assert(owns(componentTypeId<T>()));
+        return reinterpret_cast<T*>(chunks[chunk]->data + columns[columnOf[componentTypeId<T>()]].offset);
+    }
+
+private:
+    std::vector<ArchetypeColumn> columns;
+    std::array<int8_t, MAX_COMPONENTS> columnOf;
+    ComponentMask mask = 0;
+    size_t capacity = 0;
+    size_t count = 0;
+    std::vector<std::unique_ptr<ArchetypeChunk>> chunks;
+    std::vector<uint32_t> sparse;
+
+    EntityID& entityAt(size_t row) {
+        return reinterpret_cast<EntityID*>(chunks[row / capacity]->data)[row % capacity];
+    }
+
+    EntityID entityAt(size_t row) const {
+        return reinterpret_cast<const EntityID*>(chunks[row / capacity]->data)[row % capacity];
+    }
+
+    static void raiseTick(std::atomic<uint32_t>& target, uint32_t tick) {
+        if (target.load(std::memory_order_relaxed) < tick) target.store(tick, std::memory_order_relaxed);
+    }
+
+    std::byte* cell(const ArchetypeColumn& column, size_t row) {
+        return chunks[row / capacity]->data + column.offset + column.size * (row % capacity);
+    }
+};
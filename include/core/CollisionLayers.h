@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+// Биты слоёв коллизий. Значения до бита 15 заняты движком, остальные свободны для игры
+namespace CollisionLayer {
+    constexpr uint32_t Default = 1u << 0;
+    constexpr uint32_t World = 1u << 1;
+    constexpr uint32_t Debris = 1u << 2;
+    constexpr uint32_t Trigger = 1u << 3;
+    constexpr uint32_t All = 0xFFFFFFFFu;
+}
+
+// Слой, в котором лежит коллайдер, и маска слоёв, с которыми он сталкивается.
+// Пара проверяется, только если слой каждого входит в маску другого
+struct CollisionFilter {
+    uint32_t layer = CollisionLayer::Default;
+    uint32_t mask = CollisionLayer::All;
+
+    bool interacts(const CollisionFilter& other) const {
+        return (layer & other.mask) != 0 && (other.layer & mask) != 0;
+    }
+
+    // Фильтр группы коллайдеров: если группа не взаимодействует с other,
+    // то и ни один коллайдер в ней
+    static CollisionFilter merged(const CollisionFilter& a, const CollisionFilter& b) {
+        return CollisionFilter{ a.layer | b.layer, a.mask | b.mask };
+    }
+
+    // Запрос без фильтрации
+    static CollisionFilter any() {
+        return CollisionFilter{ CollisionLayer::All, CollisionLayer::All };
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Entity.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Базовая часть пула: разреженное множество сущностей и такты изменений.
+// Не зависит от типа компонента, поэтому проверки и фильтры обходятся без виртуальных вызовов
+class IComponentPool {
+public:
+    static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+    virtual ~IComponentPool() = default;
+
+    bool contains(EntityID entity) const {
+        uint32_t slot = entityIndex(entity);
+        return slot < sparse.size() && sparse[slot] != npos && packed[sparse[slot]] == entity;
+    }
+
+    size_t indexOf(EntityID entity) const {
+        assert(contains(entity));
+        return sparse[entityIndex(entity)];
+    }
+
+    size_t size() const { return packed.size(); }
+    const EntityID* entities() const { return packed.data(); }
+
+    // Такт добавления и последней записи компонента на позиции index
+    uint32_t addedTick(size_t index) const { return addedTicks[index]; }
+    uint32_t changedTick(size_t index) const { return changedTicks[index]; }
+    void markChanged(size_t index, uint32_t tick) { changedTicks[index] = tick; }
+
+    virtual void remove(EntityID entity) = 0;
+    virtual void swapEntries(size_t a, size_t b) = 0;
+
+    // Перенос компонента в чужую память и обратно, нужен архетипному хранилищу.
+    // Такты переносит вызывающий: компонент при переезде не добавлен и не записан заново
+    virtual void moveTo(EntityID entity, void* destination) = 0;
+    virtual void insertFrom(EntityID entity, void* source, uint32_t added, uint32_t changed) = 0;
+
+protected:
+    std::vector<uint32_t> sparse;
+    std::vector<EntityID> packed;
+    std::vector<uint32_t> addedTicks;
+    std::vector<uint32_t> changedTicks;
+};
+
+// Разреженное множество: плотный массив компонентов + индекс слота сущности -> позиция в нём.
+// В плотном массиве хранится полный дескриптор, поэтому устаревший дескриптор не найдётся
+template<typename T>
+class ComponentPool : public IComponentPool {
+public:
+    T& insert(EntityID entity, T component, uint32_t tick) {
+        if (contains(entity)) {
+            size_t index = sparse[entityIndex(entity)];
+            changedTicks[index] = tick;
+            return dense[index] = std::move(component);
+        }
+        uint32_t slot = entityIndex(entity);
+        if (slot >= sparse.size()) {
+            sparse.resize(static_cast<size_t>(slot) + 1, npos);
+        }
+        sparse[slot] = static_cast<uint32_t>(dense.size());
+        packed.push_back(entity);
+        addedTicks.push_back(tick);
+        changedTicks.push_back(tick);
+        dense.push_back(std::move(component));
+        return dense.back();
+    }
+
+    T& get(EntityID entity) {
+        return dense[indexOf(entity)];
+    }
+
+    const T& get(EntityID entity) const {
+        return dense[indexOf(entity)];
+    }
+
+    T* tryGet(EntityID entity) {
+        return contains(entity) ? &dense[sparse[entityIndex(entity)]] : nullptr;
+    }
+
+    // Удаление через swap-and-pop: последний элемент переезжает на место удалённого
+    void remove(EntityID entity) override {
+        if (!contains(entity)) return;
+        uint32_t index = sparse[entityIndex(entity)];
+        uint32_t last = static_cast<uint32_t>(dense.size() - 1);
+        if (index != last) {
+            dense[index] = std::move(dense[last]);
+            packed[index] = packed[last];
+            addedTicks[index] = addedTicks[last];
+            changedTicks[index] = changedTicks[last];
+            sparse[entityIndex(packed[index])] = index;
+        }
+        dense.pop_back();
+        packed.pop_back();
+        addedTicks.pop_back();
+        changedTicks.pop_back();
+        sparse[entityIndex(entity)] = npos;
+    }
+
+    // Меняет местами две позиции плотного массива; нужно группам, чтобы держать своих в начале
+    void swapEntries(size_t a, size_t b) override {
+        if (a == b) return;
+        std::swap(dense[a], dense[b]);
+        std::swap(packed[a], packed[b]);
+        std::swap(addedTicks[a], addedTicks[b]);
+        std::swap(changedTicks[a], changedTicks[b]);
+        sparse[entityIndex(packed[a])] = static_cast<uint32_t>(a);
+        sparse[entityIndex(packed[b])] = static_cast<uint32_t>(b);
+    }
+
+    void moveTo(EntityID entity, void* destination) override {
+        new (destination) T(std::move(get(entity)));
+        remove(entity);
+    }
+
+    void insertFrom(EntityID entity, void* source, uint32_t added, uint32_t changed) override {
+        insert(entity, std::move(*static_cast<T*>(source)), changed);
+        addedTicks[indexOf(entity)] = added;
+    }
+
+    T* data() { return dense.data(); }
+    const T* data() const { return dense.data(); }
+
+private:
+    std::vector<T> dense;
+};
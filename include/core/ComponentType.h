@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <type_traits>
+
+using ComponentTypeID = uint32_t;
+using ComponentMask = uint64_t;
+
+// Одна битовая маска на сущность, поэтому число типов компонентов ограничено её шириной
+constexpr ComponentTypeID MAX_COMPONENTS = 64;
+
+namespace detail {
+    inline ComponentTypeID nextComponentTypeId() {
+        static std::atomic<ComponentTypeID> counter{ 0 };
+        ComponentTypeID id = counter++;
+        assert(id < MAX_COMPONENTS && "Too many component types");
+        return id;
+    }
+}
+
+// Плотный номер типа компонента, выдаётся при первом обращении
+template<typename T>
+struct ComponentTypeId {
+    static ComponentTypeID value() {
+        static const ComponentTypeID id = detail::nextComponentTypeId();
+        return id;
+    }
+
+    static ComponentMask mask() {
+        return ComponentMask(1) << value();
+    }
+};
+
+template<typename T>
+ComponentTypeID componentTypeId() {
+    return ComponentTypeId<std::remove_cv_t<T>>::value();
+}
+
+template<typename... Ts>
+ComponentMask componentMask() {
+    return (ComponentMask(0) | ... | ComponentTypeId<std::remove_cv_t<Ts>>::mask());
+}
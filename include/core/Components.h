@@ -3,25 +3,52 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <cstdint>
+
+#include "CollisionLayers.h"
 
 
 
 struct TransformComponent {
     glm::vec3 position;
-    glm::vec3 rotation; //   
+    glm::vec3 rotation; // Для будущей поддержки
     glm::vec3 scale = glm::vec3(1.0f);
 };
 
+// Положение на начало последнего шага симуляции. Рендер смешивает его с текущим
+// TransformComponent, чтобы движение было плавным при любой частоте кадров
+struct PreviousTransformComponent {
+    glm::vec3 position;
+};
+
 struct PhysicsComponent {
     glm::vec3 velocity;
     bool onGround = true;
     float mass = 1.0f;
     float gravityMultiplier = 1.0f;
+    // Спящее тело пропускают физика, движение и коллизии, пока его не разбудят
+    // ввод или контакт. restingFrames - сколько кадров подряд тело почти не двигалось
+    bool sleeping = false;
+    uint32_t restingFrames = 0;
+
+    void wake() {
+        sleeping = false;
+        restingFrames = 0;
+    }
 };
 
 struct ColliderComponent {
     glm::vec3 halfExtents;
     float maxExtent;
+    CollisionFilter filter;
+};
+
+// Несплошной объём: тела проходят сквозь него, а CollisionSystem сообщает о входе
+// и выходе. Положение берётся из TransformComponent; коллайдера с физикой у той же
+// сущности быть не должно
+struct TriggerComponent {
+    glm::vec3 halfExtents;
+    CollisionFilter filter{ CollisionLayer::Trigger, CollisionLayer::Default };
 };
 
 struct MovementComponent {
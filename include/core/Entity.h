@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+// Дескриптор сущности: младшие биты - индекс слота, старшие - поколение.
+// После destroyEntity поколение слота растёт, и старые дескрипторы перестают совпадать
+using EntityID = uint32_t;
+
+constexpr uint32_t ENTITY_INDEX_BITS = 20;
+constexpr uint32_t ENTITY_INDEX_MASK = (1u << ENTITY_INDEX_BITS) - 1;
+constexpr uint32_t ENTITY_GENERATION_MASK = (1u << (32 - ENTITY_INDEX_BITS)) - 1;
+
+constexpr EntityID NULL_ENTITY = 0xFFFFFFFFu;
+
+// Последнее поколение не выдаётся живым сущностям: им помечаются
+// временные дескрипторы, созданные в EntityCommandBuffer
+constexpr uint32_t PLACEHOLDER_GENERATION = ENTITY_GENERATION_MASK;
+
+constexpr uint32_t entityIndex(EntityID entity) {
+    return entity & ENTITY_INDEX_MASK;
+}
+
+constexpr uint32_t entityGeneration(EntityID entity) {
+    return entity >> ENTITY_INDEX_BITS;
+}
+
+constexpr EntityID makeEntity(uint32_t index, uint32_t generation) {
+    return ((generation & ENTITY_GENERATION_MASK) << ENTITY_INDEX_BITS) | (index & ENTITY_INDEX_MASK);
+}
+
+constexpr bool isPlaceholder(EntityID entity) {
+    return entity != NULL_ENTITY && entityGeneration(entity) == PLACEHOLDER_GENERATION;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Entity.h"
+#include "EntityManager.h"
+#include "JobSystem.h"
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Отложенные структурные изменения. Команды пишутся подряд в байтовый буфер,
+// который после playback очищается без освобождения памяти
+class EntityCommandBuffer {
+public:
+    // Возвращает временный дескриптор, который годится только для команд этого же буфера
+    EntityID createEntity() {
+        EntityID placeholder = makeEntity(createdCount++, PLACEHOLDER_GENERATION);
+        write(CommandHeader{ nullptr, placeholder, 0 }, nullptr);
+        return placeholder;
+    }
+
+    void destroyEntity(EntityID entity) {
+        write(CommandHeader{ &applyDestroy, entity, 0 }, nullptr);
+    }
+
+    template<typename T>
+    void addComponent(EntityID entity, const T& component) {
+        static_assert(std::is_trivially_copyable_v<T>, "Deferred components must be trivially copyable");
+        write(CommandHeader{ &applyAdd<T>, entity, sizeof(T) }, &component);
+    }
+
+    template<typename T>
+    void removeComponent(EntityID entity) {
+        write(CommandHeader{ &applyRemove<T>, entity, 0 }, nullptr);
+    }
+
+    bool empty() const { return arena.empty(); }
+
+    // Команды применяются в порядке записи; команды для уже уничтоженных сущностей пропускаются
+    void playback(EntityManager& manager) {
+        created.clear();
+        size_t offset = 0;
+        while (offset < arena.size()) {
+            CommandHeader header;
+            std::memcpy(&header, arena.data() + offset, sizeof(header));
+            offset += sizeof(header);
+
+            if (!header.apply) {
+                created.push_back(manager.createEntity());
+            }
+            else {
+                EntityID entity = resolve(header.entity);
+                if (manager.isAlive(entity)) header.apply(manager, entity, arena.data() + offset);
+            }
+            offset += header.size;
+        }
+        arena.clear();
+        createdCount = 0;
+    }
+
+private:
+    using ApplyFn = void (*)(EntityManager&, EntityID, const std::byte*);
+
+    // apply == nullptr означает создание сущности
+    struct CommandHeader {
+        ApplyFn apply;
+        EntityID entity;
+        uint32_t size;
+    };
+
+    std::vector<std::byte> arena;
+    std::vector<EntityID> created;
+    uint32_t createdCount = 0;
+
+    void write(const CommandHeader& header, const void* payload) {
+        size_t offset = arena.size();
+        arena.resize(offset + sizeof(header) + header.size);
+        std::memcpy(arena.data() + offset, &header, sizeof(header));
+        if (header.size) std::memcpy(arena.data() + offset + sizeof(header), payload, header.size);
+    }
+
+    EntityID resolve(EntityID entity) const {
+        if (!isPlaceholder(entity)) return entity;
+        assert(entityIndex(entity) < created.size());
+        return created[entityIndex(entity)];
+    }
+
+    static void applyDestroy(EntityManager& manager, EntityID entity, const std::byte*) {
+        manager.destroyEntity(entity);
+    }
+
+    template<typename T>
+    static void applyAdd(EntityManager& manager, EntityID entity, const std::byte* payload) {
+        T component;
+        std::memcpy(&component, payload, sizeof(T));
+        manager.addComponent(entity, component);
+    }
+
+    template<typename T>
+    static void applyRemove(EntityManager& manager, EntityID entity, const std::byte*) {
+        manager.removeComponent<T>(entity);
+    }
+};
+
+// По буферу на каждый поток системы задач: системы пишут без блокировок,
+// а в точке синхронизации кадра буферы применяются по очереди
+class EntityCommandBuffers {
+public:
+    explicit EntityCommandBuffers(const JobSystem& jobs) {
+        for (size_t i = 0; i < jobs.threadCount(); ++i) {
+            buffers.push_back(std::make_unique<EntityCommandBuffer>());
+        }
+    }
+
+    EntityCommandBuffer& local() {
+        return *buffers[JobSystem::threadIndex()];
+    }
+
+    void playback(EntityManager& manager) {
+        for (auto& buffer : buffers) {
+            if (!buffer->empty()) buffer->playback(manager);
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<EntityCommandBuffer>> buffers;
+};
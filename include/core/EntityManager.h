@@ -1,75 +1,318 @@
 #pragma once
 
 #include "Components.h"
+#include "Entity.h"
+#include "ComponentPool.h"
+#include "Archetype.h"
+#include "ComponentType.h"
+#include "View.h"
+#include "JobSystem.h"
 #include "Logger.h"
 #include <glm/glm.hpp>
-#include <unordered_map>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <memory>
 #include <vector>
-#include <any>
-#include <typeindex>
 #include <string>
 #include <algorithm>
-
-using EntityID = uint32_t;
+#include <type_traits>
+#include <utility>
 
 
 class EntityManager {
 public:
+    // Освободившиеся слоты переиспользуются, их поколение уже увеличено в destroyEntity
     EntityID createEntity() {
-        return nextID++;
+        uint32_t index;
+        if (!freeList.empty()) {
+            index = freeList.back();
+            freeList.pop_back();
+        }
+        else {
+            index = static_cast<uint32_t>(generations.size());
+            assert(index < ENTITY_INDEX_MASK && "Entity index space exhausted");
+            generations.push_back(0);
+            masks.push_back(0);
+        }
+        return makeEntity(index, generations[index]);
+    }
+
+    void destroyEntity(EntityID entity) {
+        if (!isAlive(entity)) return;
+        uint32_t index = entityIndex(entity);
+        if (archetype) archetype->remove(entity);
+        for (size_t group = 0; group < groups.size(); ++group) {
+            if ((masks[index] & groups[group].owned) == groups[group].owned) leaveGroup(group, entity);
+        }
+        forEachType(masks[index], [&](ComponentTypeID type) { pools[type]->remove(entity); });
+        masks[index] = 0;
+        generations[index] = (generations[index] + 1) % PLACEHOLDER_GENERATION;
+        freeList.push_back(index);
+    }
+
+    bool isAlive(EntityID entity) const {
+        uint32_t index = entityIndex(entity);
+        return index < generations.size() && generations[index] == entityGeneration(entity);
+    }
+
+    // Сущности с полным набором компонентов архетипа переезжают в его чанки.
+    // Вызывается один раз при настройке сцены, уже существующие сущности переносятся сразу
+    template<typename... Components>
+    void useArchetype() {
+        assert(!archetype && "Only one archetype storage is supported");
+        for (const auto& group : groups) assert((group.owned & componentMask<Components...>()) == 0);
+        archetype = Archetype::create<Components...>();
+        (getPool<Components>(), ...);
+        ComponentMask owned = archetype->getMask();
+        for (uint32_t index = 0; index < masks.size(); ++index) {
+            if ((masks[index] & owned) == owned) moveToArchetype(makeEntity(index, generations[index]));
+        }
+    }
+
+    // Владеющая группа: в пулах Components сущности со всеми этими компонентами
+    // держатся в начале и на одинаковых позициях, поэтому выборка по ним идёт по
+    // параллельным массивам без проверок. Пул может принадлежать только одной группе
+    template<typename... Components>
+    void useGroup() {
+        ComponentMask owned = componentMask<Components...>();
+        assert(!archetype || (archetype->getMask() & owned) == 0);
+        for (const auto& group : groups) assert((group.owned & owned) == 0 && "Pool already owned by a group");
+        (getPool<Components>(), ...);
+
+        size_t group = groups.size();
+        groups.push_back(OwningGroup{ owned, 0 });
+        forEachType(owned, [&](ComponentTypeID type) { groupOf[type] = static_cast<int8_t>(group); });
+        for (uint32_t index = 0; index < masks.size(); ++index) {
+            if ((masks[index] & owned) == owned) enterGroup(group, makeEntity(index, generations[index]));
+        }
     }
 
     template<typename T>
     void addComponent(EntityID entity, T component) {
-        components[typeid(T)][entity] = component;
+        assert(isAlive(entity));
+        if (ownedByArchetype<T>(entity)) {
+            archetype->get<T>(entity) = std::move(component);
+            archetype->markChanged(archetype->chunkOf(entity), componentTypeId<T>(), currentTick());
+            return;
+        }
+        getPool<T>().insert(entity, std::move(component), currentTick());
+        uint32_t index = entityIndex(entity);
+        masks[index] |= ComponentTypeId<T>::mask();
+        if (archetype && archetype->owns(componentTypeId<T>()) && (masks[index] & archetype->getMask()) == archetype->getMask()) {
+            moveToArchetype(entity);
+        }
+        int8_t group = groupOf[componentTypeId<T>()];
+        if (group >= 0 && (masks[index] & groups[group].owned) == groups[group].owned && !inGroup(group, entity)) {
+            enterGroup(group, entity);
+        }
     }
 
+    template<typename T>
+    void removeComponent(EntityID entity) {
+        if (!hasComponent<T>(entity)) return;
+        if (ownedByArchetype<T>(entity)) {
+            moveFromArchetype(entity, componentTypeId<T>());
+        }
+        else {
+            int8_t group = groupOf[componentTypeId<T>()];
+            if (group >= 0 && (masks[entityIndex(entity)] & groups[group].owned) == groups[group].owned) {
+                leaveGroup(group, entity);
+            }
+            findPool<T>()->remove(entity);
+        }
+        masks[entityIndex(entity)] &= ~ComponentTypeId<T>::mask();
+    }
+
+    // Изменяемый доступ считается записью и обновляет такт изменения компонента
     template<typename T>
     T& getComponent(EntityID entity) {
-        return std::any_cast<T&>(components[typeid(T)][entity]);
+        if (ownedByArchetype<T>(entity)) {
+            archetype->markChanged(archetype->chunkOf(entity), componentTypeId<T>(), currentTick());
+            return archetype->get<T>(entity);
+        }
+        ComponentPool<T>& pool = getPool<T>();
+        size_t index = pool.indexOf(entity);
+        pool.markChanged(index, currentTick());
+        return pool.data()[index];
+    }
+
+    template<typename T>
+    const T& getComponent(EntityID entity) const {
+        if (ownedByArchetype<T>(entity)) return std::as_const(*archetype).template get<T>(entity);
+        return findPool<T>()->get(entity);
     }
 
+    template<typename T>
+    T* tryGetComponent(EntityID entity) {
+        return hasComponent<T>(entity) ? &getComponent<T>(entity) : nullptr;
+    }
+
+    template<typename T>
+    const T* tryGetComponent(EntityID entity) const {
+        return hasComponent<T>(entity) ? &getComponent<T>(entity) : nullptr;
+    }
+
+    // Такт, которым помечаются записи. Система, которой нужны изменения с прошлого
+    // запуска, в начале вызывает advanceTick и фильтрует по такту предыдущего вызова
+    uint32_t currentTick() const { return tick.load(std::memory_order_relaxed); }
+    uint32_t advanceTick() { return ++tick; }
+
     template<typename T>
     bool hasComponent(EntityID entity) const {
-        auto it = components.find(typeid(T));
-        if (it == components.end()) return false;
-        return it->second.find(entity) != it->second.end();
+        return isAlive(entity) && (masks[entityIndex(entity)] & ComponentTypeId<T>::mask()) != 0;
     }
 
-    //     
-    std::vector<EntityID> getEntitiesWithComponents(const std::vector<std::type_index>& types) const {
+    // Получение сущностей с определенными компонентами
+    template<typename... Components>
+    std::vector<EntityID> getEntitiesWith() {
         std::vector<EntityID> result;
-        for (const auto& [type, entityMap] : components) {
-            if (type == types[0]) {
-                for (const auto& [entity, _] : entityMap) {
-                    bool hasAll = true;
-                    for (size_t i = 1; i < types.size(); ++i) {
-                        if (!hasComponent(entity, types[i])) {
-                            hasAll = false;
-                            break;
-                        }
-                    }
-                    if (hasAll) result.push_back(entity);
-                }
-                break;
-            }
-        }
+        each<const Components...>([&](EntityID entity, const Components&...) { result.push_back(entity); });
         return result;
     }
 
+    // Выборка без аллокаций; пулы не создаются, если их ещё нет
     template<typename... Components>
-    std::vector<EntityID> getEntitiesWith() {
-        std::vector<std::type_index> types = { typeid(Components)... };
-        return getEntitiesWithComponents(types);
+    View<Components...> view() {
+        return View<Components...>(masks, archetype.get(), groupRange(componentMask<Components...>()), currentTick(),
+            findPool<std::remove_const_t<Components>>()...);
+    }
+
+    // fn(EntityID, Components&...) для каждой сущности со всеми компонентами
+    template<typename... Components, typename Func>
+    void each(Func&& fn) {
+        view<Components...>().each(std::forward<Func>(fn));
+    }
+
+    // То же, что each, но выборка делится на куски по grain и обходится потоками jobs.
+    // fn вызывается конкурентно и не должен менять состав компонентов
+    template<typename... Components, typename Func>
+    void parallelEach(JobSystem* jobs, size_t grain, Func&& fn) {
+        auto selection = view<Components...>();
+        if (!jobs) {
+            selection.each(fn);
+            return;
+        }
+        jobs->parallelFor(selection.sizeHint(), grain, [&](size_t begin, size_t end) {
+            selection.each(begin, end, fn);
+        });
     }
 
 private:
-    EntityID nextID = 0;
-    std::unordered_map<std::type_index, std::unordered_map<EntityID, std::any>> components;
+    // Поколение и маска компонентов для каждого слота, свободные слоты ждут переиспользования
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> freeList;
+    // Пулы лежат в плоском массиве по номеру типа, маска сущности хранит набор её компонентов
+    std::array<std::unique_ptr<IComponentPool>, MAX_COMPONENTS> pools;
+    std::vector<ComponentMask> masks;
+    std::unique_ptr<Archetype> archetype;
+    std::atomic<uint32_t> tick{ 1 };
+
+    struct OwningGroup {
+        ComponentMask owned;
+        size_t size;
+    };
+    std::vector<OwningGroup> groups;
+    std::array<int8_t, MAX_COMPONENTS> groupOf = makeGroupIndex();
+
+    static std::array<int8_t, MAX_COMPONENTS> makeGroupIndex() {
+        std::array<int8_t, MAX_COMPONENTS> index;
+        index.fill(-1);
+        return index;
+    }
+
+    template<typename Func>
+    static void forEachType(ComponentMask mask, Func&& fn) {
+        for (ComponentTypeID type = 0; mask != 0; ++type, mask >>= 1) {
+            if (mask & 1) fn(type);
+        }
+    }
+
+    // Сущность группы лежит в пулах раньше позиции size
+    bool inGroup(size_t group, EntityID entity) const {
+        ComponentMask owned = groups[group].owned;
+        ComponentTypeID first = 0;
+        while (!(owned & 1)) {
+            owned >>= 1;
+            ++first;
+        }
+        return pools[first]->indexOf(entity) < groups[group].size;
+    }
 
-    bool hasComponent(EntityID entity, std::type_index type) const {
-        auto it = components.find(type);
-        if (it == components.end()) return false;
-        return it->second.find(entity) != it->second.end();
+    void enterGroup(size_t group, EntityID entity) {
+        size_t position = groups[group].size++;
+        forEachType(groups[group].owned, [&](ComponentTypeID type) {
+            pools[type]->swapEntries(pools[type]->indexOf(entity), position);
+        });
+    }
+
+    // Вызывается до удаления компонента, пока сущность ещё лежит в префиксе группы
+    void leaveGroup(size_t group, EntityID entity) {
+        if (!inGroup(group, entity)) return;
+        size_t position = --groups[group].size;
+        forEachType(groups[group].owned, [&](ComponentTypeID type) {
+            pools[type]->swapEntries(pools[type]->indexOf(entity), position);
+        });
+    }
+
+    // Префикс группы, покрывающий выборку: все её типы принадлежат одной группе
+    GroupRange groupRange(ComponentMask required) const {
+        ComponentMask probe = required;
+        ComponentTypeID first = 0;
+        while (probe && !(probe & 1)) {
+            probe >>= 1;
+            ++first;
+        }
+        if (!probe || groupOf[first] < 0) return GroupRange{};
+        const OwningGroup& group = groups[groupOf[first]];
+        if ((group.owned & required) != required) return GroupRange{};
+        return GroupRange{ group.size, group.owned == required };
+    }
+
+    template<typename T>
+    bool ownedByArchetype(EntityID entity) const {
+        return archetype && archetype->owns(componentTypeId<T>()) && archetype->contains(entity);
+    }
+
+    // Переезд не считается ни добавлением, ни записью: такты компонентов едут вместе с ними
+    void moveToArchetype(EntityID entity) {
+        archetype->insert(entity);
+        size_t chunk = archetype->chunkOf(entity);
+        forEachType(archetype->getMask(), [&](ComponentTypeID type) {
+            size_t index = pools[type]->indexOf(entity);
+            uint32_t added = pools[type]->addedTick(index), changed = pools[type]->changedTick(index);
+            pools[type]->moveTo(entity, archetype->component(type, entity));
+            archetype->raiseTicks(chunk, type, added, changed);
+        });
+    }
+
+    // Возвращаем компоненты архетипа в пулы, кроме удаляемого. Точнее тактов чанка
+    // про строку ничего не известно, они и достаются её компонентам
+    void moveFromArchetype(EntityID entity, ComponentTypeID removed) {
+        size_t chunk = archetype->chunkOf(entity);
+        forEachType(archetype->getMask(), [&](ComponentTypeID type) {
+            if (type != removed) {
+                pools[type]->insertFrom(entity, archetype->component(type, entity),
+                    archetype->addedTick(chunk, type), archetype->changedTick(chunk, type));
+            }
+        });
+        archetype->remove(entity);
+    }
+
+    template<typename T>
+    ComponentPool<T>& getPool() {
+        auto& pool = pools[ComponentTypeId<T>::value()];
+        if (!pool) pool = std::make_unique<ComponentPool<T>>();
+        return static_cast<ComponentPool<T>&>(*pool);
+    }
+
+    template<typename T>
+    ComponentPool<T>* findPool() {
+        return static_cast<ComponentPool<T>*>(pools[ComponentTypeId<T>::value()].get());
+    }
+
+    template<typename T>
+    const ComponentPool<T>* findPool() const {
+        return static_cast<const ComponentPool<T>*>(pools[ComponentTypeId<T>::value()].get());
     }
 };
\ No newline at end of file
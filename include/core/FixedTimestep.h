@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cassert>
+
+// Накопитель для симуляции с постоянным шагом. Время кадров копится и расходуется
+// целыми шагами, так что стоимость симуляции в секунду не зависит от частоты кадров.
+// Остаток меньше шага даёт долю для интерполяции между двумя последними состояниями
+class FixedTimestep {
+public:
+    explicit FixedTimestep(float ticksPerSecond = 60.0f, int maxSubsteps = 5) : maxSubsteps(maxSubsteps) {
+        setTickRate(ticksPerSecond);
+    }
+
+    void setTickRate(float ticksPerSecond) {
+        assert(ticksPerSecond > 0.0f);
+        step = 1.0 / ticksPerSecond;
+    }
+
+    void setMaxSubsteps(int substeps) {
+        assert(substeps > 0);
+        maxSubsteps = substeps;
+    }
+
+    float getStep() const { return static_cast<float>(step); }
+
+    // Вызывает fn(step) по разу на каждый накопившийся шаг, но не больше maxSubsteps.
+    // Время сверх этого отбрасывается: под нагрузкой симуляция замедляется, а не
+    // тратит всё больше шагов на догоняние. Возвращает число выполненных шагов
+    template<typename Func>
+    int advance(double frameTime, Func&& fn) {
+        accumulator += frameTime;
+        int steps = 0;
+        while (accumulator >= step && steps < maxSubsteps) {
+            fn(static_cast<float>(step));
+            accumulator -= step;
+            ++steps;
+        }
+        if (steps == maxSubsteps && accumulator >= step) accumulator = 0.0;
+        return steps;
+    }
+
+    // Доля остатка в шаге, [0, 1): 0 - последнее состояние симуляции совпадает с кадром
+    float getAlpha() const { return static_cast<float>(accumulator / step); }
+
+private:
+    double step = 1.0 / 60.0;
+    double accumulator = 0.0;
+    int maxSubsteps;
+};
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Счётчик незавершённых задач; wait() ждёт, пока он не обнулится
+class JobCounter {
+public:
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending{ 0 };
+};
+
+// Система задач с очередью на каждый рабочий поток и кражей работы.
+// Свои задачи поток берёт с конца очереди, чужие крадёт с начала
+class JobSystem {
+public:
+    explicit JobSystem(size_t threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1) {
+        // Очередь 0 принадлежит внешним потокам (главному), остальные - рабочим
+        for (size_t i = 0; i <= threadCount; ++i) {
+            queues.push_back(std::make_unique<WorkerQueue>());
+        }
+        for (size_t i = 1; i <= threadCount; ++i) {
+            workers.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Число потоков, которые могут выполнять задачи, включая вызывающий wait()
+    size_t threadCount() const { return queues.size(); }
+
+    // 0 для главного и прочих внешних потоков, 1..N для рабочих
+    static size_t threadIndex() { return currentThreadIndex(); }
+
+    void submit(std::function<void()> task, JobCounter* counter = nullptr) {
+        if (counter) counter->pending.fetch_add(1, std::memory_order_relaxed);
+        WorkerQueue& queue = *queues[threadIndex() < queues.size() ? threadIndex() : 0];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(Job{ std::move(task), counter });
+        }
+        queuedJobs.fetch_add(1, std::memory_order_release);
+        {
+            // Без захвата мьютекса поток может уснуть между проверкой условия и ожиданием
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // Пока задачи счётчика не выполнены, вызывающий поток помогает выполнять очередь
+    void wait(JobCounter& counter) {
+        size_t self = threadIndex() < queues.size() ? threadIndex() : 0;
+        while (!counter.done()) {
+            if (!runOne(self)) std::this_thread::yield();
+        }
+    }
+
+    // Выполняет одну задачу из очередей, если она есть. Для потоков, которые ждут
+    // не JobCounter, а своё условие, и должны помогать, а не спать
+    bool tryRunOne() {
+        return runOne(threadIndex() < queues.size() ? threadIndex() : 0);
+    }
+
+    // Делит [0, count) на куски по grain элементов и выполняет fn(begin, end) параллельно
+    template<typename Func>
+    void parallelFor(size_t count, size_t grain, Func&& fn) {
+        if (count == 0) return;
+        grain = std::max<size_t>(grain, 1);
+        if (count <= grain || queues.size() == 1) {
+            fn(size_t(0), count);
+            return;
+        }
+        JobCounter counter;
+        // Последний кусок вызывающий поток выполняет сам
+        size_t begin = 0;
+        for (; begin + grain < count; begin += grain) {
+            size_t end = begin + grain;
+            submit([&fn, begin, end] { fn(begin, end); }, &counter);
+        }
+        fn(begin, count);
+        wait(counter);
+    }
+
+private:
+    struct Job {
+        std::function<void()> task;
+        JobCounter* counter = nullptr;
+    };
+
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<int> queuedJobs{ 0 };
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    static size_t& currentThreadIndex() {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    bool popOwn(size_t self, Job& job) {
+        WorkerQueue& queue = *queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) return false;
+        job = std::move(queue.jobs.back());
+        queue.jobs.pop_back();
+        return true;
+    }
+
+    bool steal(size_t self, Job& job) {
+        for (size_t offset = 1; offset < queues.size(); ++offset) {
+            WorkerQueue& queue = *queues[(self + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty()) continue;
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    bool runOne(size_t self) {
+        Job job;
+        if (!popOwn(self, job) && !steal(self, job)) return false;
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        job.task();
+        if (job.counter) job.counter->pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void workerLoop(size_t self) {
+        currentThreadIndex() = self;
+        for (;;) {
+            if (runOne(self)) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this] { return stopping || queuedJobs.load(std::memory_order_acquire) > 0; });
+            if (stopping) return;
+        }
+    }
+};
@@ -5,8 +5,12 @@
 
 class Logger {
 public:
+    // Подробные сообщения из покадровых циклов. Вызов проверяет флаг до сборки
+    // строки, чтобы выключенный лог не выделял память каждый кадр
+    static constexpr bool verbose = false;
+
     static void log(const std::string& message) {
-        //      
+        // В продакшене можно записывать в файл
         
     }
 };
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "ComponentType.h"
+#include "JobSystem.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Списки компонентов, которые система читает и пишет
+template<typename... Ts> struct Reads {};
+template<typename... Ts> struct Writes {};
+
+// Запускает системы кадра параллельно там, где их наборы компонентов не конфликтуют.
+// Порядок регистрации задаёт порядок для конфликтующих систем
+class SystemScheduler {
+public:
+    explicit SystemScheduler(JobSystem& jobs) : jobs(jobs) {}
+
+    // mainThread - система должна выполняться в потоке, который вызывает run (например, OpenGL)
+    template<typename... R, typename... W>
+    void addSystem(const std::string& name, Reads<R...>, Writes<W...>, std::function<void(float)> update, bool mainThread = false) {
+        SystemEntry entry;
+        entry.name = name;
+        entry.reads = componentMask<R...>();
+        entry.writes = componentMask<W...>();
+        entry.update = std::move(update);
+        entry.mainThread = mainThread;
+        systems.push_back(std::move(entry));
+        buildGraph();
+    }
+
+    void run(float deltaTime) {
+        std::vector<size_t> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            frameDeltaTime = deltaTime;
+            completed = 0;
+            for (size_t i = 0; i < systems.size(); ++i) {
+                systems[i].remaining = systems[i].dependencyCount;
+                if (systems[i].remaining == 0) ready.push_back(i);
+            }
+        }
+        for (size_t i : ready) dispatch(i);
+
+        // Поток кадра сам выполняет системы, привязанные к нему, и помогает с очередью задач,
+        // как JobSystem::wait: без рабочих потоков иначе никто не выполнит остальные системы
+        std::unique_lock<std::mutex> lock(mutex);
+        while (completed < systems.size()) {
+            if (!mainQueue.empty()) {
+                size_t index = mainQueue.back();
+                mainQueue.pop_back();
+                lock.unlock();
+                execute(index);
+                lock.lock();
+                continue;
+            }
+            // Новые задачи появляются только перед завершением системы, поэтому спать можно,
+            // пока completed не изменился с момента, когда очередь оказалась пустой
+            size_t seen = completed;
+            lock.unlock();
+            bool ran = jobs.tryRunOne();
+            lock.lock();
+            if (!ran) done.wait(lock, [&] { return completed != seen || !mainQueue.empty(); });
+        }
+    }
+
+private:
+    struct SystemEntry {
+        std::string name;
+        ComponentMask reads = 0;
+        ComponentMask writes = 0;
+        std::function<void(float)> update;
+        bool mainThread = false;
+        size_t dependencyCount = 0;
+        size_t remaining = 0;
+        std::vector<size_t> dependents;
+    };
+
+    JobSystem& jobs;
+    std::vector<SystemEntry> systems;
+    std::vector<size_t> mainQueue;
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t completed = 0;
+    float frameDeltaTime = 0.0f;
+
+    static bool conflicts(const SystemEntry& a, const SystemEntry& b) {
+        return (a.writes & (b.reads | b.writes)) != 0 || (b.writes & a.reads) != 0;
+    }
+
+    // Ребро i -> j, если j зарегистрирована позже и обращается к тем же компонентам
+    void buildGraph() {
+        for (auto& system : systems) {
+            system.dependencyCount = 0;
+            system.dependents.clear();
+        }
+        for (size_t i = 0; i < systems.size(); ++i) {
+            for (size_t j = i + 1; j < systems.size(); ++j) {
+                if (conflicts(systems[i], systems[j])) {
+                    systems[i].dependents.push_back(j);
+                    ++systems[j].dependencyCount;
+                }
+            }
+        }
+    }
+
+    void dispatch(size_t index) {
+        if (systems[index].mainThread) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                mainQueue.push_back(index);
+            }
+            done.notify_all();
+        }
+        else {
+            jobs.submit([this, index] { execute(index); });
+        }
+    }
+
+    void execute(size_t index) {
+        systems[index].update(frameDeltaTime);
+
+        std::vector<size_t> ready;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t dependent : systems[index].dependents) {
+                if (--systems[dependent].remaining == 0) ready.push_back(dependent);
+            }
+        }
+        for (size_t i : ready) dispatch(i);
+
+        // Уведомляем под мьютексом: после последнего completed run() может вернуться и освободить планировщик
+        std::lock_guard<std::mutex> lock(mutex);
+        ++completed;
+        done.notify_all();
+    }
+};
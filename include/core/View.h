@@ -0,0 +1,217 @@
+#pragma once
+
+#include "Archetype.h"
+#include "ComponentPool.h"
+#include "ComponentType.h"
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// Префикс владеющей группы: первые size позиций всех пулов выборки выровнены.
+// exact - выборка совпадает с группой, и за префиксом подходящих сущностей нет
+struct GroupRange {
+    size_t size = 0;
+    bool exact = false;
+};
+
+// Фильтры выборки: компонент записан / добавлен не раньше такта since
+template<typename T> struct Changed { uint32_t since; };
+template<typename T> struct Added { uint32_t since; };
+
+// Выборка сущностей, у которых есть все компоненты Ts. Ничего не выделяет:
+// обходит самый маленький из пулов, принадлежность проверяется одной маской.
+// Если часть Ts хранится в архетипе, его чанки обходятся отдельно и первыми.
+// Компоненты без const считаются записанными: их такт изменения обновляется
+template<typename... Ts>
+class View {
+    template<typename T>
+    using PoolOf = ComponentPool<std::remove_const_t<T>>;
+
+public:
+    View(const std::vector<ComponentMask>& masks, Archetype* archetype, GroupRange group, uint32_t tick, PoolOf<Ts>*... pools)
+        : masks(masks), required(componentMask<Ts...>()), archetype(archetype), group(group), tick(tick), pools(pools...) {
+        ownedRequired = archetype ? (archetype->getMask() & required) : 0;
+    }
+
+    template<typename T>
+    View& where(Changed<T> filter) {
+        addFilter<T>(filter.since, false);
+        return *this;
+    }
+
+    template<typename T>
+    View& where(Added<T> filter) {
+        addFilter<T>(filter.since, true);
+        return *this;
+    }
+
+    // Верхняя граница числа сущностей в выборке. Кандидаты нумеруются подряд:
+    // сначала строки архетипа, затем элементы ведущего пула
+    size_t sizeHint() const {
+        const IComponentPool* driver = smallest();
+        if (!driver) return 0;
+        return archetypeRows() + poolCandidates(driver);
+    }
+
+    template<typename Func>
+    void each(Func&& fn) const {
+        each(0, sizeHint(), fn);
+    }
+
+    // Обход кандидатов [begin, end), чтобы делить выборку между потоками
+    template<typename Func>
+    void each(size_t begin, size_t end, Func&& fn) const {
+        const IComponentPool* driver = smallest();
+        if (!driver) return;
+        size_t rows = archetypeRows();
+        if (begin < rows) eachInArchetype(begin, std::min(end, rows), fn);
+
+        const EntityID* entities = driver->entities();
+        size_t first = begin - std::min(begin, rows);
+        size_t last = std::min(end - std::min(end, rows), poolCandidates(driver));
+
+        // Внутри префикса группы проверять нечего, позиции во всех пулах совпадают
+        for (size_t i = first; i < std::min(last, group.size); ++i) {
+            if (filterCount && !passesAt(i)) continue;
+            (markAt<Ts>(i), ...);
+            fn(entities[i], std::get<PoolOf<Ts>*>(pools)->data()[i]...);
+        }
+        for (size_t i = std::max(first, group.size); i < last; ++i) {
+            EntityID entity = entities[i];
+            if ((masks[entityIndex(entity)] & required) != required) continue;
+            if (ownedRequired && archetype->contains(entity)) continue;
+            if (filterCount && !passes(entity)) continue;
+            (markAt<Ts>(std::get<PoolOf<Ts>*>(pools)->indexOf(entity)), ...);
+            fn(entity, std::get<PoolOf<Ts>*>(pools)->get(entity)...);
+        }
+    }
+
+private:
+    struct TickFilter {
+        const IComponentPool* pool;
+        ComponentTypeID type;
+        uint32_t since;
+        bool added;
+    };
+
+    const std::vector<ComponentMask>& masks;
+    ComponentMask required;
+    ComponentMask ownedRequired = 0;
+    Archetype* archetype;
+    GroupRange group;
+    uint32_t tick;
+    std::tuple<PoolOf<Ts>*...> pools;
+    std::array<TickFilter, 4> filters{};
+    size_t filterCount = 0;
+
+    template<typename T>
+    void addFilter(uint32_t since, bool added) {
+        static_assert((std::is_same_v<std::remove_const_t<Ts>, T> || ...), "Filtered component must be part of the view");
+        assert(filterCount < filters.size());
+        filters[filterCount++] = TickFilter{ std::get<PoolOf<T>*>(pools), componentTypeId<T>(), since, added };
+    }
+
+    size_t poolCandidates(const IComponentPool* driver) const {
+        return group.exact ? group.size : driver->size();
+    }
+
+    const IComponentPool* smallest() const {
+        if (((std::get<PoolOf<Ts>*>(pools) == nullptr) || ...)) return nullptr;
+        const IComponentPool* result = nullptr;
+        ((result = (!result || std::get<PoolOf<Ts>*>(pools)->size() < result->size())
+            ? std::get<PoolOf<Ts>*>(pools) : result), ...);
+        return result;
+    }
+
+    static bool passesTick(const IComponentPool* pool, size_t index, const TickFilter& filter) {
+        return (filter.added ? pool->addedTick(index) : pool->changedTick(index)) >= filter.since;
+    }
+
+    bool passesAt(size_t index) const {
+        for (size_t f = 0; f < filterCount; ++f) {
+            if (!passesTick(filters[f].pool, index, filters[f])) return false;
+        }
+        return true;
+    }
+
+    bool passes(EntityID entity) const {
+        for (size_t f = 0; f < filterCount; ++f) {
+            if (!passesTick(filters[f].pool, filters[f].pool->indexOf(entity), filters[f])) return false;
+        }
+        return true;
+    }
+
+    template<typename T>
+    void markAt(size_t index) const {
+        if constexpr (!std::is_const_v<T>) std::get<PoolOf<T>*>(pools)->markChanged(index, tick);
+    }
+
+    size_t archetypeRows() const {
+        return ownedRequired ? archetype->size() : 0;
+    }
+
+    // Фильтры по колонкам архетипа проверяются для чанка целиком
+    bool chunkPasses(size_t chunk) const {
+        for (size_t f = 0; f < filterCount; ++f) {
+            const TickFilter& filter = filters[f];
+            if (!archetype->owns(filter.type)) continue;
+            uint32_t value = filter.added ? archetype->addedTick(chunk, filter.type) : archetype->changedTick(chunk, filter.type);
+            if (value < filter.since) return false;
+        }
+        return true;
+    }
+
+    bool rowPasses(EntityID entity) const {
+        for (size_t f = 0; f < filterCount; ++f) {
+            const TickFilter& filter = filters[f];
+            if (archetype->owns(filter.type)) continue;
+            if (!passesTick(filter.pool, filter.pool->indexOf(entity), filter)) return false;
+        }
+        return true;
+    }
+
+    // Колонки архетипа идут подряд; компоненты вне архетипа добираются из пулов
+    template<typename Func>
+    void eachInArchetype(size_t beginRow, size_t endRow, Func& fn) const {
+        size_t capacity = archetype->chunkCapacity();
+        for (size_t chunk = beginRow / capacity; chunk * capacity < endRow; ++chunk) {
+            if (filterCount && !chunkPasses(chunk)) continue;
+            const EntityID* entities = archetype->entities(chunk);
+            std::tuple<std::remove_const_t<Ts>*...> columns(columnOrNull<std::remove_const_t<Ts>>(chunk)...);
+            size_t first = std::max(beginRow, chunk * capacity) - chunk * capacity;
+            size_t last = std::min(endRow - chunk * capacity, archetype->chunkSize(chunk));
+            bool visited = false;
+            for (size_t row = first; row < last; ++row) {
+                EntityID entity = entities[row];
+                if ((masks[entityIndex(entity)] & required) != required) continue;
+                if (filterCount && !rowPasses(entity)) continue;
+                visited = true;
+                fn(entity, fetch<Ts>(std::get<std::remove_const_t<Ts>*>(columns), row, entity)...);
+            }
+            if (visited) (markChunk<Ts>(chunk), ...);
+        }
+    }
+
+    template<typename T>
+    T* columnOrNull(size_t chunk) const {
+        return (ownedRequired & ComponentTypeId<T>::mask()) ? archetype->column<T>(chunk) : nullptr;
+    }
+
+    template<typename T>
+    T& fetch(std::remove_const_t<T>* column, size_t row, EntityID entity) const {
+        if (column) return column[row];
+        if constexpr (!std::is_const_v<T>) markAt<T>(std::get<PoolOf<T>*>(pools)->indexOf(entity));
+        return std::get<PoolOf<T>*>(pools)->get(entity);
+    }
+
+    template<typename T>
+    void markChunk(size_t chunk) const {
+        if constexpr (!std::is_const_v<T>) {
+            if (ownedRequired & ComponentTypeId<std::remove_const_t<T>>::mask()) {
+                archetype->markChanged(chunk, componentTypeId<T>(), tick);
+            }
+        }
+    }
+};
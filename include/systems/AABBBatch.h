@@ -0,0 +1,228 @@
+#pragma once
+
+#include "Collider.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Боксы в SoA-раскладке: по массиву на каждую границу. За последним боксом
+// лежит SIMD_WIDTH заглушек, которые ни с чем не пересекаются, поэтому пакет
+// можно читать целиком с любой позиции без проверок на хвост
+class AABBSoA {
+public:
+#if defined(XGAME_SIMD_AVX2)
+    static constexpr size_t SIMD_WIDTH = 8;
+#else
+    static constexpr size_t SIMD_WIDTH = 4;
+#endif
+
+    void resize(size_t size) {
+        count = size;
+        constexpr float inf = std::numeric_limits<float>::infinity();
+        for (int axis = 0; axis < 3; ++axis) {
+            mins[axis].assign(size + SIMD_WIDTH, inf);
+            maxs[axis].assign(size + SIMD_WIDTH, -inf);
+        }
+    }
+
+    void set(size_t index, const AABB& box) {
+        assert(index < count);
+        for (int axis = 0; axis < 3; ++axis) {
+            mins[axis][index] = box.min[axis];
+            maxs[axis][index] = box.max[axis];
+        }
+    }
+
+    AABB get(size_t index) const {
+        return AABB{ glm::vec3(mins[0][index], mins[1][index], mins[2][index]),
+            glm::vec3(maxs[0][index], maxs[1][index], maxs[2][index]) };
+    }
+
+    size_t size() const { return count; }
+    const float* minData(int axis) const { return mins[axis].data(); }
+    const float* maxData(int axis) const { return maxs[axis].data(); }
+
+private:
+    size_t count = 0;
+    std::vector<float> mins[3];
+    std::vector<float> maxs[3];
+};
+
+namespace aabb_batch {
+    // Число боксов, проверяемых одним вызовом overlapMask
+    constexpr size_t MASK_BITS = 32;
+
+    inline unsigned lowestBit(uint32_t mask) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+    // Бит i результата - пересекается ли box с боксом first + i. Та же проверка,
+    // что в AABB::overlaps, поэтому совпадает с векторными версиями бит в бит
+    inline uint32_t overlapMaskScalar(const AABB& box, const AABBSoA& boxes, size_t first, size_t count) {
+        assert(count <= MASK_BITS && first + count <= boxes.size());
+        uint32_t mask = 0;
+        for (size_t i = 0; i < count; ++i) {
+            bool hit = true;
+            for (int axis = 0; axis < 3; ++axis) {
+                hit = hit && box.min[axis] <= boxes.maxData(axis)[first + i] && box.max[axis] >= boxes.minData(axis)[first + i];
+            }
+            mask |= uint32_t(hit) << i;
+        }
+        return mask;
+    }
+
+    inline uint32_t overlapMask(const AABB& box, const AABBSoA& boxes, size_t first, size_t count) {
+        assert(count <= MASK_BITS && first + count <= boxes.size());
+#if defined(XGAME_SIMD_AVX2)
+        __m256 boxMin[3], boxMax[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            boxMin[axis] = _mm256_set1_ps(box.min[axis]);
+            boxMax[axis] = _mm256_set1_ps(box.max[axis]);
+        }
+        uint32_t mask = 0;
+        for (size_t offset = 0; offset < count; offset += 8) {
+            __m256 hit = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int axis = 0; axis < 3; ++axis) {
+                __m256 otherMin = _mm256_loadu_ps(boxes.minData(axis) + first + offset);
+                __m256 otherMax = _mm256_loadu_ps(boxes.maxData(axis) + first + offset);
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(boxMin[axis], otherMax, _CMP_LE_OQ));
+                hit = _mm256_and_ps(hit, _mm256_cmp_ps(boxMax[axis], otherMin, _CMP_GE_OQ));
+            }
+            mask |= uint32_t(_mm256_movemask_ps(hit)) << offset;
+        }
+        return count == MASK_BITS ? mask : mask & ((uint32_t(1) << count) - 1);
+#elif defined(XGAME_SIMD_SSE2)
+        __m128 boxMin[3], boxMax[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            boxMin[axis] = _mm_set1_ps(box.min[axis]);
+            boxMax[axis] = _mm_set1_ps(box.max[axis]);
+        }
+        uint32_t mask = 0;
+        for (size_t offset = 0; offset < count; offset += 4) {
+            __m128 hit = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int axis = 0; axis < 3; ++axis) {
+                __m128 otherMin = _mm_loadu_ps(boxes.minData(axis) + first + offset);
+                __m128 otherMax = _mm_loadu_ps(boxes.maxData(axis) + first + offset);
+                hit = _mm_and_ps(hit, _mm_cmple_ps(boxMin[axis], otherMax));
+                hit = _mm_and_ps(hit, _mm_cmpge_ps(boxMax[axis], otherMin));
+            }
+            mask |= uint32_t(_mm_movemask_ps(hit)) << offset;
+        }
+        return count == MASK_BITS ? mask : mask & ((uint32_t(1) << count) - 1);
+#else
+        return overlapMaskScalar(box, boxes, first, count);
+#endif
+    }
+
+    // fn(index) для каждого бокса из [first, first + count), пересекающего box
+    template<typename Func>
+    void forEachOverlap(const AABB& box, const AABBSoA& boxes, size_t first, size_t count, Func&& fn) {
+        for (size_t block = 0; block < count; block += MASK_BITS) {
+            size_t blockSize = std::min(MASK_BITS, count - block);
+            uint32_t mask = overlapMask(box, boxes, first + block, blockSize);
+            while (mask) {
+                unsigned bit = lowestBit(mask);
+                mask &= mask - 1;
+                fn(first + block + bit);
+            }
+        }
+    }
+    // Как forEachOverlap, но боксы, для которых accept(index) ложно, отбрасываются
+    // до геометрической проверки; блок без принятых боксов не проверяется вовсе
+    template<typename Accept, typename Func>
+    void forEachOverlapFiltered(const AABB& box, const AABBSoA& boxes, size_t first, size_t count, Accept&& accept, Func&& fn) {
+        for (size_t block = 0; block < count; block += MASK_BITS) {
+            size_t blockSize = std::min(MASK_BITS, count - block);
+            uint32_t accepted = 0;
+            for (size_t i = 0; i < blockSize; ++i) accepted |= uint32_t(accept(first + block + i)) << i;
+            if (!accepted) continue;
+            uint32_t mask = overlapMask(box, boxes, first + block, blockSize) & accepted;
+            while (mask) {
+                unsigned bit = lowestBit(mask);
+                mask &= mask - 1;
+                fn(first + block + bit);
+            }
+        }
+    }
+
+    // Пакет лучей в SoA-раскладке. Пустые дорожки имеют maxDistance < 0
+    // и ни с чем не пересекаются
+    constexpr size_t RAY_PACKET_SIZE = 8;
+
+    struct RayPacket {
+        alignas(32) float origin[3][RAY_PACKET_SIZE];
+        alignas(32) float inverseDirection[3][RAY_PACKET_SIZE];
+        alignas(32) float maxDistance[RAY_PACKET_SIZE];
+    };
+
+    // Бит i результата - входит ли луч i в бокс на отрезке [0, maxDistance];
+    // entries[i] - расстояние входа. Тот же метод пластин и тот же порядок min/max,
+    // что в StaticBVH::rayHits, поэтому результаты совпадают бит в бит
+    inline uint32_t rayMaskScalar(const glm::vec3& min, const glm::vec3& max, const RayPacket& packet, float* entries) {
+        uint32_t mask = 0;
+        for (size_t ray = 0; ray < RAY_PACKET_SIZE; ++ray) {
+            float entry = 0.0f, exit = packet.maxDistance[ray];
+            float nearest[3], farthest[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                float t1 = (min[axis] - packet.origin[axis][ray]) * packet.inverseDirection[axis][ray];
+                float t2 = (max[axis] - packet.origin[axis][ray]) * packet.inverseDirection[axis][ray];
+                nearest[axis] = std::min(t1, t2);
+                farthest[axis] = std::max(t1, t2);
+            }
+            entry = std::max(std::max(nearest[0], nearest[1]), std::max(nearest[2], 0.0f));
+            exit = std::min(std::min(farthest[0], farthest[1]), std::min(farthest[2], exit));
+            entries[ray] = entry;
+            mask |= uint32_t(entry <= exit) << ray;
+        }
+        return mask;
+    }
+
+    inline uint32_t rayMask(const glm::vec3& min, const glm::vec3& max, const RayPacket& packet, float* entries) {
+#if defined(XGAME_SIMD_AVX2)
+        // _mm256_min_ps(b, a) == (a < b ? a : b) - как std::min(a, b), в том числе для NaN
+        __m256 nearest[3], farthest[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            __m256 origin = _mm256_load_ps(packet.origin[axis]);
+            __m256 inverse = _mm256_load_ps(packet.inverseDirection[axis]);
+            __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(min[axis]), origin), inverse);
+            __m256 t2 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(max[axis]), origin), inverse);
+            nearest[axis] = _mm256_min_ps(t2, t1);
+            farthest[axis] = _mm256_max_ps(t2, t1);
+        }
+        __m256 entry = _mm256_max_ps(_mm256_max_ps(_mm256_setzero_ps(), nearest[2]), _mm256_max_ps(nearest[1], nearest[0]));
+        __m256 exit = _mm256_min_ps(_mm256_min_ps(_mm256_load_ps(packet.maxDistance), farthest[2]), _mm256_min_ps(farthest[1], farthest[0]));
+        _mm256_storeu_ps(entries, entry);
+        return uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ)));
+#elif defined(XGAME_SIMD_SSE2)
+        uint32_t mask = 0;
+        for (size_t offset = 0; offset < RAY_PACKET_SIZE; offset += 4) {
+            __m128 nearest[3], farthest[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                __m128 origin = _mm_load_ps(packet.origin[axis] + offset);
+                __m128 inverse = _mm_load_ps(packet.inverseDirection[axis] + offset);
+                __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(min[axis]), origin), inverse);
+                __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(max[axis]), origin), inverse);
+                nearest[axis] = _mm_min_ps(t2, t1);
+                farthest[axis] = _mm_max_ps(t2, t1);
+            }
+            __m128 entry = _mm_max_ps(_mm_max_ps(_mm_setzero_ps(), nearest[2]), _mm_max_ps(nearest[1], nearest[0]));
+            __m128 exit = _mm_min_ps(_mm_min_ps(_mm_load_ps(packet.maxDistance + offset), farthest[2]), _mm_min_ps(farthest[1], farthest[0]));
+            _mm_storeu_ps(entries + offset, entry);
+            mask |= uint32_t(_mm_movemask_ps(_mm_cmple_ps(entry, exit))) << offset;
+        }
+        return mask;
+#else
+        return rayMaskScalar(min, max, packet, entries);
+#endif
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Collider.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Пара пересекающихся прокси в виде их userData, порядок внутри пары не задан
+using BroadphasePair = std::pair<uint32_t, uint32_t>;
+
+// Общий интерфейс широкой фазы для подвижных коллайдеров, чтобы реализации
+// можно было менять и сравнивать на одних и тех же сценах
+class IBroadphase {
+public:
+    virtual ~IBroadphase() = default;
+
+    // Пары прокси, чьи фильтры не взаимодействуют, отбрасываются внутри обхода,
+    // до проверки боксов
+    virtual int32_t createProxy(const AABB& box, uint32_t userData, const CollisionFilter& filter) = 0;
+    virtual void destroyProxy(int32_t proxy) = 0;
+    // displacement - смещение тела за кадр; возвращает true, если структура изменилась
+    virtual bool moveProxy(int32_t proxy, const AABB& box, const glm::vec3& displacement) = 0;
+    // Заменяет содержимое pairs всеми парами, чьи боксы пересекаются, а фильтры взаимодействуют
+    virtual void findPairs(std::vector<BroadphasePair>& pairs) = 0;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "core/CollisionLayers.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <limits>
+
+// Ось-ориентированный ограничивающий параллелепипед
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    static AABB fromCenter(const glm::vec3& center, const glm::vec3& halfExtents) {
+        return AABB{ center - halfExtents, center + halfExtents };
+    }
+
+    // Пустой бокс, который растёт через grow
+    static AABB empty() {
+        constexpr float inf = std::numeric_limits<float>::infinity();
+        return AABB{ glm::vec3(inf), glm::vec3(-inf) };
+    }
+
+    void grow(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void grow(const AABB& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    static AABB merged(const AABB& a, const AABB& b) {
+        return AABB{ glm::min(a.min, b.min), glm::max(a.max, b.max) };
+    }
+
+    bool contains(const AABB& other) const {
+        return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+    }
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+
+    float surfaceArea() const {
+        glm::vec3 size = max - min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    bool overlaps(const AABB& other) const {
+        return (min.x <= other.max.x && max.x >= other.min.x) &&
+            (min.y <= other.max.y && max.y >= other.min.y) &&
+            (min.z <= other.max.z && max.z >= other.min.z);
+    }
+
+    AABB expanded(float margin) const {
+        return AABB{ min - glm::vec3(margin), max + glm::vec3(margin) };
+    }
+};
+
+struct Collider {
+    glm::vec3 center;
+    glm::vec3 halfExtents;
+    float maxExtent;
+    CollisionFilter filter;
+
+    Collider(const glm::vec3& position, float size, const CollisionFilter& filter = worldFilter())
+        : center(position), halfExtents(size), maxExtent(size), filter(filter) {}
+    Collider(const glm::vec3& position, const glm::vec3& scale, const CollisionFilter& filter = worldFilter())
+        : center(position), filter(filter) {
+        halfExtents = scale * 0.5f;
+        maxExtent = glm::length(halfExtents);
+    }
+    glm::vec3 getClosestPoint(const glm::vec3& point) const {
+        glm::vec3 closest;
+        closest.x = glm::clamp(point.x, center.x - halfExtents.x, center.x + halfExtents.x);
+        closest.y = glm::clamp(point.y, center.y - halfExtents.y, center.y + halfExtents.y);
+        closest.z = glm::clamp(point.z, center.z - halfExtents.z, center.z + halfExtents.z);
+        return closest;
+    }
+
+    AABB bounds() const {
+        return AABB::fromCenter(center, halfExtents);
+    }
+
+    // Статика по умолчанию лежит в слое World и сталкивается со всеми
+    static CollisionFilter worldFilter() {
+        return CollisionFilter{ CollisionLayer::World, CollisionLayer::All };
+    }
+};
+
+// Время первого касания бокса moving, движущегося на motion, с неподвижным target.
+// Сводится к лучу из центра moving против target, расширенного на полуразмеры moving.
+// time в [0, 1] - доля motion до касания, normal - нормаль грани target, которой
+// коснулись. Боксы, пересекающиеся уже в начале, не считаются касанием
+inline bool sweepAABB(const AABB& moving, const glm::vec3& motion, const AABB& target, float& time, glm::vec3& normal) {
+    glm::vec3 halfExtents = (moving.max - moving.min) * 0.5f;
+    glm::vec3 origin = moving.center();
+    glm::vec3 expandedMin = target.min - halfExtents;
+    glm::vec3 expandedMax = target.max + halfExtents;
+
+    float entry = -std::numeric_limits<float>::infinity();
+    float exit = std::numeric_limits<float>::infinity();
+    int entryAxis = -1;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (motion[axis] == 0.0f) {
+            if (origin[axis] <= expandedMin[axis] || origin[axis] >= expandedMax[axis]) return false;
+            continue;
+        }
+        float t1 = (expandedMin[axis] - origin[axis]) / motion[axis];
+        float t2 = (expandedMax[axis] - origin[axis]) / motion[axis];
+        float axisEntry = std::min(t1, t2), axisExit = std::max(t1, t2);
+        if (axisEntry > entry) {
+            entry = axisEntry;
+            entryAxis = axis;
+        }
+        exit = std::min(exit, axisExit);
+    }
+    if (entryAxis < 0 || entry > exit || entry < 0.0f || entry > 1.0f) return false;
+
+    time = entry;
+    normal = glm::vec3(0.0f);
+    normal[entryAxis] = motion[entryAxis] > 0.0f ? -1.0f : 1.0f;
+    return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "core/JobSystem.h"
+#include "systems/CollisionSystem.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+struct Ray {
+    glm::vec3 origin;
+    // Не обязано быть единичным, расстояния считаются в его длинах
+    glm::vec3 direction;
+    float maxDistance = 1000.0f;
+};
+
+struct RayHit {
+    bool hit = false;
+    float distance = 0.0f;
+    glm::vec3 point = glm::vec3(0.0f);
+    glm::vec3 normal = glm::vec3(0.0f);
+    uint32_t collider = 0;
+};
+
+// Запросы к статическим коллайдерам мира поверх структур CollisionSystem: лучи,
+// пакеты лучей, пересечение и заметание бокса. Фильтр отбирает слои, которые видит запрос. Запросы только читают структуры,
+// поэтому их можно вызывать из разных потоков, пока CollisionSystem не выполняет update.
+// Структура поиска строится в update, поэтому после addStaticCollider нужен хотя бы один update
+class CollisionQueries {
+public:
+    explicit CollisionQueries(const CollisionSystem& collisions) : collisions(collisions) {}
+
+    // Ближайшее попадание луча
+    RayHit raycast(const Ray& ray, const CollisionFilter& filter = CollisionFilter::any()) const {
+        RayHit result;
+        float closest = ray.maxDistance;
+        collisions.getStaticBVH().queryRay(ray.origin, ray.direction, ray.maxDistance, filter, [&](uint32_t index, float entry) {
+            if (!result.hit || entry < closest) {
+                closest = entry;
+                result.hit = true;
+                result.collider = index;
+            }
+            return closest;
+        });
+        if (result.hit) finishHit(ray, closest, result);
+        return result;
+    }
+
+    // hits[i] - результат для rays[i]. Лучи идут пакетами по StaticBVH::PACKET_SIZE
+    // в порядке массива, так что близкие лучи лучше класть рядом. С jobs пакеты
+    // делятся между потоками
+    void raycastBatch(const Ray* rays, size_t count, RayHit* hits, JobSystem* jobs = nullptr,
+        const CollisionFilter& filter = CollisionFilter::any()) const {
+        size_t packetCount = (count + StaticBVH::PACKET_SIZE - 1) / StaticBVH::PACKET_SIZE;
+        auto run = [&](size_t begin, size_t end) {
+            for (size_t packet = begin; packet < end; ++packet) {
+                size_t first = packet * StaticBVH::PACKET_SIZE;
+                raycastPacket(rays + first, std::min(StaticBVH::PACKET_SIZE, count - first), hits + first, filter);
+            }
+        };
+        if (jobs) jobs->parallelFor(packetCount, packetsPerJob, run);
+        else run(0, packetCount);
+    }
+
+    // fn(index) для статических коллайдеров, пересекающих box; возвращает их число
+    template<typename Func>
+    size_t overlapBox(const AABB& box, Func&& fn, const CollisionFilter& filter = CollisionFilter::any()) const {
+        return collisions.queryStaticColliders(box, filter, std::forward<Func>(fn));
+    }
+
+    size_t overlapBox(const AABB& box, uint32_t* indices, size_t capacity, const CollisionFilter& filter = CollisionFilter::any()) const {
+        return collisions.queryStaticColliders(box, indices, capacity, filter);
+    }
+
+    // Первое касание бокса, движущегося на motion
+    bool sweepBox(const AABB& box, const glm::vec3& motion, SweepHit& hit, const CollisionFilter& filter = CollisionFilter::any()) const {
+        return collisions.sweepStatic(box, motion, hit, filter);
+    }
+
+private:
+    static constexpr size_t packetsPerJob = 32;
+
+    const CollisionSystem& collisions;
+
+    void raycastPacket(const Ray* rays, size_t count, RayHit* hits, const CollisionFilter& filter) const {
+        glm::vec3 origins[StaticBVH::PACKET_SIZE];
+        glm::vec3 directions[StaticBVH::PACKET_SIZE];
+        float closest[StaticBVH::PACKET_SIZE];
+        for (size_t i = 0; i < count; ++i) {
+            origins[i] = rays[i].origin;
+            directions[i] = rays[i].direction;
+            closest[i] = rays[i].maxDistance;
+            hits[i] = RayHit{};
+        }
+        collisions.getStaticBVH().queryRayPacket(origins, directions, closest, count, filter, [&](size_t ray, uint32_t index, float entry) {
+            if (!hits[ray].hit || entry < hits[ray].distance) {
+                hits[ray].hit = true;
+                hits[ray].distance = entry;
+                hits[ray].collider = index;
+            }
+            return hits[ray].distance;
+        });
+        for (size_t i = 0; i < count; ++i) {
+            if (hits[i].hit) finishHit(rays[i], hits[i].distance, hits[i]);
+        }
+    }
+
+    // Точка и нормаль по расстоянию: нормаль - ось грани, через которую луч вошёл
+    void finishHit(const Ray& ray, float distance, RayHit& hit) const {
+        hit.distance = distance;
+        hit.point = ray.origin + ray.direction * distance;
+        AABB box = collisions.getStaticCollider(hit.collider).bounds();
+        glm::vec3 inverse = 1.0f / ray.direction;
+        glm::vec3 t1 = (box.min - ray.origin) * inverse;
+        glm::vec3 t2 = (box.max - ray.origin) * inverse;
+        glm::vec3 tNear = glm::min(t1, t2);
+        int axis = tNear.x > tNear.y ? (tNear.x > tNear.z ? 0 : 2) : (tNear.y > tNear.z ? 1 : 2);
+        hit.normal = glm::vec3(0.0f);
+        // Луч из точки внутри бокса не входит через грань
+        if (tNear[axis] >= 0.0f) hit.normal[axis] = ray.direction[axis] > 0.0f ? -1.0f : 1.0f;
+    }
+};
@@ -6,151 +6,499 @@
 
 #include "core/Components.h"
 #include "core/EntityManager.h"
+#include "systems/Collider.h"
+#include "systems/ContactCache.h"
+#include "systems/ContactSolver.h"
+#include "systems/SpatialHashGrid.h"
+#include "systems/StaticBVH.h"
+#include "systems/DynamicAABBTree.h"
+#include "systems/SweepAndPrune.h"
+#include <cassert>
+#include <chrono>
 
-struct Collider {
-    glm::vec3 center;
-    glm::vec3 halfExtents;
-    float maxExtent;
-
-    Collider(const glm::vec3& position, float size) : center(position), halfExtents(size), maxExtent(size) {}
-    Collider(const glm::vec3& position, const glm::vec3& scale) : center(position) {
-        halfExtents = scale * 0.5f;
-        maxExtent = glm::length(halfExtents);
-    }
-    glm::vec3 getClosestPoint(const glm::vec3& point) const {
-        glm::vec3 closest;
-        closest.x = glm::clamp(point.x, center.x - halfExtents.x, center.x + halfExtents.x);
-        closest.y = glm::clamp(point.y, center.y - halfExtents.y, center.y + halfExtents.y);
-        closest.z = glm::clamp(point.z, center.z - halfExtents.z, center.z + halfExtents.z);
-        return closest;
-    }
+// Структура поиска по статическим коллайдерам
+enum class StaticBroadphase {
+    BVH,
+    HashGrid
 };
 
+// Касание при заметании: доля пути, нормаль грани и индекс статического коллайдера
+struct SweepHit {
+    float time;
+    glm::vec3 normal;
+    uint32_t collider;
+};
 
+// Широкая фаза для пар подвижных тел
+enum class DynamicBroadphase {
+    AABBTree,
+    SweepAndPrune
+};
 
 class CollisionSystem {
 public:
     void addStaticCollider(const Collider& collider) {
         staticColliders.push_back(collider);
+        staticDirty = true;
+    }
+
+    // Структура перестраивается при следующем update
+    void setStaticBroadphase(StaticBroadphase broadphase) {
+        staticBroadphase = broadphase;
+        staticDirty = true;
+    }
+
+    // Прокси всех тел пересоздаются в новой структуре при следующем update
+    void setDynamicBroadphase(DynamicBroadphase broadphase) {
+        if (broadphase == DynamicBroadphase::SweepAndPrune) dynamicBroadphase = std::make_unique<SweepAndPrune>();
+        else dynamicBroadphase = std::make_unique<DynamicAABBTree>();
+        for (auto& proxy : dynamicProxies) proxy.proxy = nullProxy;
+    }
+
+    // Размер ячейки сетки статических коллайдеров, сетка перестроится при следующем update
+    void setCellSize(float cellSize) {
+        grid.setCellSize(cellSize);
+        staticDirty = true;
+    }
+
+    // fn(index) для каждого статического коллайдера, чей AABB пересекает area, а слой
+    // взаимодействует с filter. Ничего не выделяет и безопасна для одновременных вызовов;
+    // структура поиска перестраивается в update, поэтому после addStaticCollider нужен
+    // хотя бы один update. Возвращает число найденных коллайдеров
+    template<typename Func>
+    size_t queryStaticColliders(const AABB& area, const CollisionFilter& filter, Func&& fn) const {
+        size_t found = 0;
+        auto visit = [&](uint32_t index) {
+            ++found;
+            fn(index);
+        };
+        if (staticBroadphase == StaticBroadphase::BVH) bvh.query(area, filter, visit);
+        else grid.query(area, filter, visit);
+        return found;
+    }
+
+    template<typename Func>
+    size_t queryStaticColliders(const AABB& area, Func&& fn) const {
+        return queryStaticColliders(area, CollisionFilter::any(), std::forward<Func>(fn));
+    }
+
+    // Записывает в indices не больше capacity индексов и возвращает полное число
+    // найденных: если оно больше capacity, буфер стоит увеличить и повторить запрос
+    size_t queryStaticColliders(const AABB& area, uint32_t* indices, size_t capacity, const CollisionFilter& filter = CollisionFilter::any()) const {
+        return queryStaticColliders(area, filter, [&, written = size_t(0)](uint32_t index) mutable {
+            if (written < capacity) indices[written++] = index;
+        });
+    }
+
+    // Самое раннее касание бокса, движущегося на motion, со статическими коллайдерами
+    bool sweepStatic(const AABB& box, const glm::vec3& motion, SweepHit& hit, const CollisionFilter& filter = CollisionFilter::any()) const {
+        AABB swept = AABB::merged(box, AABB{ box.min + motion, box.max + motion });
+        bool found = false;
+        hit.time = 1.0f;
+        queryStaticColliders(swept, filter, [&](uint32_t index) {
+            float time;
+            glm::vec3 normal;
+            if (sweepAABB(box, motion, staticColliders[index].bounds(), time, normal) && (!found || time < hit.time)) {
+                hit = SweepHit{ time, normal, index };
+                found = true;
+            }
+        });
+        return found;
+    }
+
+    // События контактов последнего update: начало, продолжение и конец касания
+    // тела со статикой или с другим телом. Действительны до следующего update
+    const std::vector<ContactEvent>& getContactEvents() const { return contacts.getEvents(); }
+
+    // События триггеров последнего update: Begin - тело вошло в объём, Persist - остаётся
+    // в нём, End - вышло. contact.entity - триггер, contact.other - тело
+    const std::vector<ContactEvent>& getTriggerEvents() const { return triggerContacts.getEvents(); }
+
+    const StaticBVH& getStaticBVH() const { return bvh; }
+    const Collider& getStaticCollider(uint32_t index) const { return staticColliders[index]; }
+    size_t staticColliderCount() const { return staticColliders.size(); }
+
+    // Тело засыпает, если frames кадров подряд стоит на опоре со скоростью ниже velocity.
+    // frames == 0 отключает сон
+    void setSleepThreshold(float velocity, uint32_t frames) {
+        sleepVelocity = velocity;
+        sleepFrames = frames;
+    }
+
+    // Итерации решателя контактов: скоростные гасят сближение и трение, позиционные
+    // выталкивают из перекрытий. Высокой стопке нужно больше скоростных итераций
+    void setSolverIterations(int velocity, int position) {
+        solver.setIterations(velocity, position);
+    }
+
+    // Коэффициент трения между телами и между телом и статикой
+    void setFriction(float friction) {
+        solver.setFriction(friction);
+    }
+
+    // Сущности проверяются независимо друг от друга, поэтому обход делится между потоками
+    void setJobSystem(JobSystem& jobSystem) {
+        jobs = &jobSystem;
     }
 
     void update(EntityManager& manager, float deltaTime) {
-        for (auto entity : manager.getEntitiesWith<TransformComponent, ColliderComponent, PhysicsComponent>()) {
-            auto& transform = manager.getComponent<TransformComponent>(entity);
-            auto& collider = manager.getComponent<ColliderComponent>(entity);
-            auto& physics = manager.getComponent<PhysicsComponent>(entity);
+        if (staticDirty) {
+            buildStaticBroadphase();
+        }
+        contacts.beginFrame(jobs ? jobs->threadCount() : 1);
+        triggerContacts.beginFrame(1);
+
+        // Выборка только читает, чтобы спящие и стоящие на месте тела не получали такт изменения;
+        // итог записывается через getComponent, только если он отличается от прежнего
+        manager.parallelEach<const TransformComponent, const ColliderComponent, const PhysicsComponent>(jobs, 64, [&](EntityID entity, const TransformComponent& transform, const ColliderComponent& collider, const PhysicsComponent& physics) {
+            if (physics.sleeping) return;
 
             glm::vec3 oldPosition = transform.position;
             glm::vec3 proposedPosition = transform.position;
 
-            //     MovementComponent,  
-            if (manager.hasComponent<MovementComponent>(entity)) {
-                auto& movement = manager.getComponent<MovementComponent>(entity);
-                proposedPosition += movement.groundVelocity * deltaTime;
+            // Учитываем горизонтальное движение из MovementComponent, если есть
+            if (auto* movement = std::as_const(manager).tryGetComponent<MovementComponent>(entity)) {
+                proposedPosition += movement->groundVelocity * deltaTime;
             }
 
-            bool collisionDetected = false;
-            auto nearbyColliders = getNearbyColliders(proposedPosition, collider);
-            Logger::log("Entity " + std::to_string(entity) + " nearby colliders: " + std::to_string(nearbyColliders.size()));
-
-            for (const auto& otherCollider : nearbyColliders) {
-                if (checkCollision(proposedPosition, collider.halfExtents, otherCollider)) {
-                    collisionDetected = true;
-
-                    //  
-                    glm::vec3 cameraMin = proposedPosition - collider.halfExtents;
-                    glm::vec3 cameraMax = proposedPosition + collider.halfExtents;
-                    glm::vec3 colliderMin = otherCollider.center - otherCollider.halfExtents;
-                    glm::vec3 colliderMax = otherCollider.center + otherCollider.halfExtents;
-
-                    //   
-                    float overlapX = std::min(cameraMax.x - colliderMin.x, colliderMax.x - cameraMin.x);
-                    float overlapY = std::min(cameraMax.y - colliderMin.y, colliderMax.y - cameraMin.y);
-                    float overlapZ = std::min(cameraMax.z - colliderMin.z, colliderMax.z - cameraMin.z);
-
-                    //   
-                    glm::vec3 normal(0.0f);
-                    float minOverlap = std::min({ overlapX, overlapY, overlapZ });
-
-                    if (minOverlap == overlapX) {
-                        normal.x = (proposedPosition.x > otherCollider.center.x) ? 1.0f : -1.0f;
-                    }
-                    else if (minOverlap == overlapY) {
-                        normal.y = (proposedPosition.y > otherCollider.center.y) ? 1.0f : -1.0f;
-                    }
-                    else {
-                        normal.z = (proposedPosition.z > otherCollider.center.z) ? 1.0f : -1.0f;
-                    }
-
-                    // 
-                    proposedPosition += -normal * minOverlap;
-
-                    // ,    
-                    if (normal.y > 0.1f && proposedPosition.y > otherCollider.center.y + otherCollider.halfExtents.y) {
-                        physics.onGround = true;
-                        physics.velocity.y = 0.0f;
-                        proposedPosition.y = otherCollider.center.y + otherCollider.halfExtents.y + collider.halfExtents.y + 0.001f;
-                        Logger::log("Entity " + std::to_string(entity) + " landed on ground: normal.y = " + std::to_string(normal.y) +
-                            ", y = " + std::to_string(proposedPosition.y));
-                        Logger::log("Collision with collider at (" + std::to_string(otherCollider.center.x) + ", " +
-                            std::to_string(otherCollider.center.y) + "), normal=(" + std::to_string(normal.x) + ", " +
-                            std::to_string(normal.y) + ", " + std::to_string(normal.z) + ")");
-                    }
-
-                    if (abs(normal.x) > 0.7f) {
-                        proposedPosition.x = transform.position.x; //    X
-                    }
-                    if (abs(normal.z) > 0.7f) {
-                        proposedPosition.z = transform.position.z; //    Z
-                    }
+            // Шаг по скорости уже сделан PhysicsSystem, поэтому движение кадра
+            // проверяется заметанием от точки до него: быстрое тело не проскочит тонкий коллайдер
+            glm::vec3 start = oldPosition - physics.velocity * deltaTime;
+            // Перекрытия, с которыми тело начало шаг, заметание не видит: их вместе с касаниями
+            // у итоговой позиции разрешает решатель контактов. Опору дают грань, на которую
+            // тело опустилось при заметании, и контакты снизу в solveContacts
+            bool onGround = false;
+            sweepMotion(start, proposedPosition - start, collider, onGround, proposedPosition);
 
-                }
-            }
+            if (proposedPosition != transform.position) manager.getComponent<TransformComponent>(entity).position = proposedPosition;
+            if (onGround != physics.onGround) manager.getComponent<PhysicsComponent>(entity).onGround = onGround;
 
-            if (!collisionDetected) {
-                physics.onGround = false;
-                Logger::log("Entity " + std::to_string(entity) + " no collision detected, onGround = false");
-            }
+            // Контакт - это статика в пределах contactMargin от итоговой позиции: тело,
+            // стоящее на зазоре contactSkin, иначе теряло бы контакт через кадр
+            AABB box = AABB::fromCenter(proposedPosition, collider.halfExtents);
+            size_t thread = jobs ? JobSystem::threadIndex() : 0;
+            queryStaticColliders(box.expanded(contactMargin), collider.filter, [&](uint32_t index) {
+                Contact contact{ entity, NULL_ENTITY, index };
+                measureContact(staticColliders[index].bounds(), box, contact);
+                contacts.add(thread, contact);
+            });
+        });
 
-            transform.position = proposedPosition;
-        }
+        resolveDynamicPairs(manager);
+        solveContacts(manager, deltaTime);
+        updateSleep(manager, deltaTime);
+
+        // Спящие тела не проверяются, но их контакты сохраняются до пробуждения
+        auto sleeping = [&](EntityID entity) {
+            auto* physics = std::as_const(manager).tryGetComponent<PhysicsComponent>(entity);
+            return physics && physics->sleeping;
+        };
+        contacts.endFrame([&](const Contact& contact) {
+            return sleeping(contact.entity) && (contact.isStatic() || sleeping(contact.other));
+        });
+        // Пары со спящими телами широкая фаза находит как обычно, так что сохранять нечего
+        triggerContacts.endFrame([](const Contact&) { return false; });
     }
 
 private:
+    static constexpr float contactSkin = 0.001f;
+    static constexpr float contactMargin = 0.01f;
+    static constexpr int maxSweepIterations = 3;
+
     std::vector<Collider> staticColliders;
+    StaticBroadphase staticBroadphase = StaticBroadphase::BVH;
+    StaticBVH bvh;
+    SpatialHashGrid grid;
+    bool staticDirty = false;
+    JobSystem* jobs = nullptr;
+    float sleepVelocity = 0.05f;
+    uint32_t sleepFrames = 30;
+
+    // Подвижные тела текущего кадра; указатели действительны до конца update и только
+    // для чтения: запись идёт через getComponent и ставит такт изменения лишь изменённым телам.
+    // movement - контроллер тела, если есть
+    struct DynamicBody {
+        EntityID entity;
+        const TransformComponent* transform;
+        const ColliderComponent* collider;
+        const PhysicsComponent* physics;
+        const MovementComponent* movement;
+    };
+
+    struct TriggerVolume {
+        EntityID entity;
+        const TransformComponent* transform;
+        const TriggerComponent* trigger;
+    };
 
-    std::vector<Collider> getNearbyColliders(const glm::vec3& position, const ColliderComponent& collider) const {
-        std::vector<Collider> nearby;
-        float cameraMaxExtent = collider.maxExtent;
-        for (const auto& otherCollider : staticColliders) {
-            float distance = glm::distance(position, otherCollider.center);
-            float threshold = cameraMaxExtent + otherCollider.maxExtent + 2.0f;
-            if (distance < threshold) {
-                nearby.push_back(otherCollider);
+    // Лист дерева для слота сущности; seen - номер кадра, в котором сущность была в выборке,
+    // endPosition - позиция в конце прошлого кадра для счёта покоя, filter - фильтр,
+    // с которым создан прокси. body - номер в dynamicBodies или, у триггера, в triggerVolumes
+    struct DynamicProxy {
+        EntityID entity = 0;
+        int32_t proxy = nullProxy;
+        CollisionFilter filter;
+        bool trigger = false;
+        uint32_t body = 0;
+        uint32_t seen = 0;
+        glm::vec3 lastPosition = glm::vec3(0.0f);
+        glm::vec3 endPosition = glm::vec3(0.0f);
+    };
+
+    static constexpr int32_t nullProxy = -1;
+
+    std::unique_ptr<IBroadphase> dynamicBroadphase = std::make_unique<DynamicAABBTree>();
+    std::vector<DynamicProxy> dynamicProxies;
+    std::vector<DynamicBody> dynamicBodies;
+    std::vector<TriggerVolume> triggerVolumes;
+    std::vector<BroadphasePair> dynamicPairs;
+    uint32_t frame = 0;
+    ContactCache contacts;
+    ContactCache triggerContacts;
+    ContactSolver solver;
+
+    // Тело проходит motion от start до первого касания, затем скользит вдоль
+    // грани остатком пути; так несколько раз, если на пути несколько граней.
+    // Скорость в грань гасит решатель по контакту у итоговой позиции.
+    // Возвращает true, если было касание
+    bool sweepMotion(const glm::vec3& start, glm::vec3 motion, const ColliderComponent& collider, bool& onGround, glm::vec3& end) const {
+        glm::vec3 position = start;
+        bool touched = false;
+        for (int iteration = 0; iteration < maxSweepIterations; ++iteration) {
+            SweepHit hit;
+            if (glm::dot(motion, motion) == 0.0f || !sweepStatic(AABB::fromCenter(position, collider.halfExtents), motion, hit, collider.filter)) {
+                position += motion;
+                motion = glm::vec3(0.0f);
+                break;
+            }
+            touched = true;
+            position += motion * hit.time + hit.normal * contactSkin;
+            motion *= 1.0f - hit.time;
+            motion -= hit.normal * glm::dot(motion, hit.normal);
+
+            if (hit.normal.y > 0.5f) onGround = true;
+        }
+        end = position;
+        return touched;
+    }
+
+    // Контакты подвижных тел друг с другом ищутся после разрешения со статикой.
+    // Пары даёт широкая фаза, а не перебор всех со всеми; триггеры лежат
+    // в той же широкой фазе, и их пары с телами дают события вместо контактов
+    void resolveDynamicPairs(EntityManager& manager) {
+        ++frame;
+        dynamicBodies.clear();
+        manager.each<const TransformComponent, const ColliderComponent, const PhysicsComponent>([&](EntityID entity, const TransformComponent& transform, const ColliderComponent& collider, const PhysicsComponent& physics) {
+            dynamicBodies.push_back(DynamicBody{ entity, &transform, &collider, &physics,
+                std::as_const(manager).tryGetComponent<MovementComponent>(entity) });
+        });
+        triggerVolumes.clear();
+        manager.each<const TransformComponent, const TriggerComponent>([&](EntityID entity, const TransformComponent& transform, const TriggerComponent& trigger) {
+            triggerVolumes.push_back(TriggerVolume{ entity, &transform, &trigger });
+        });
+
+        for (uint32_t body = 0; body < dynamicBodies.size(); ++body) {
+            const DynamicBody& current = dynamicBodies[body];
+            // Запас contactMargin даёт пары и для тел, стоящих вплотную: их нужно будить вместе
+            syncProxy(current.entity, current.transform->position, current.collider->halfExtents + glm::vec3(contactMargin),
+                current.collider->filter, body, false);
+        }
+        for (uint32_t volume = 0; volume < triggerVolumes.size(); ++volume) {
+            const TriggerVolume& current = triggerVolumes[volume];
+            syncProxy(current.entity, current.transform->position, current.trigger->halfExtents, current.trigger->filter, volume, true);
+        }
+        // Сущности, выпавшие из выборки, убираются из широкой фазы
+        for (auto& proxy : dynamicProxies) {
+            if (proxy.proxy != nullProxy && proxy.seen != frame) {
+                dynamicBroadphase->destroyProxy(proxy.proxy);
+                proxy.proxy = nullProxy;
+            }
+        }
+
+        // Пары приходят в слотах сущностей
+        dynamicBroadphase->findPairs(dynamicPairs);
+        for (const auto& pair : dynamicPairs) {
+            const DynamicProxy& first = dynamicProxies[pair.first];
+            const DynamicProxy& second = dynamicProxies[pair.second];
+            if (first.trigger || second.trigger) {
+                if (!(first.trigger && second.trigger)) {
+                    addTriggerContact(triggerVolumes[first.trigger ? first.body : second.body], dynamicBodies[first.trigger ? second.body : first.body]);
+                }
+                continue;
             }
-            Logger::log("Collider check: distance = " + std::to_string(distance) + ", threshold = " + std::to_string(threshold) +
-                ", collider center = (" + std::to_string(otherCollider.center.x) + ", " +
-                std::to_string(otherCollider.center.y) + ", " + std::to_string(otherCollider.center.z) + ")");
+            const DynamicBody& a = dynamicBodies[first.body];
+            const DynamicBody& b = dynamicBodies[second.body];
+            wakeTouching(manager, a, b);
+            addDynamicContact(a, b);
+        }
+    }
+
+    // Создаёт или двигает прокси сущности; фильтр хранится в широкой фазе,
+    // поэтому при его смене прокси пересоздаётся
+    void syncProxy(EntityID entity, const glm::vec3& position, const glm::vec3& halfExtents, const CollisionFilter& filter, uint32_t body, bool trigger) {
+        uint32_t slot = entityIndex(entity);
+        if (slot >= dynamicProxies.size()) dynamicProxies.resize(static_cast<size_t>(slot) + 1);
+        DynamicProxy& proxy = dynamicProxies[slot];
+        assert(proxy.seen != frame && "Entity is both a body and a trigger");
+        AABB box = AABB::fromCenter(position, halfExtents);
+        if (proxy.proxy != nullProxy && (proxy.entity != entity || proxy.trigger != trigger ||
+            proxy.filter.layer != filter.layer || proxy.filter.mask != filter.mask)) {
+            dynamicBroadphase->destroyProxy(proxy.proxy);
+            proxy.proxy = nullProxy;
+        }
+        if (proxy.proxy == nullProxy) {
+            proxy.proxy = dynamicBroadphase->createProxy(box, slot, filter);
+            proxy.filter = filter;
+            proxy.trigger = trigger;
+        }
+        else {
+            dynamicBroadphase->moveProxy(proxy.proxy, box, position - proxy.lastPosition);
         }
-        return nearby;
+        proxy.entity = entity;
+        proxy.body = body;
+        proxy.seen = frame;
+        proxy.lastPosition = position;
     }
 
-    bool checkCollision(const glm::vec3& point, const glm::vec3& cameraHalfExtents, const Collider& collider) const {
-        glm::vec3 cameraMin = point - cameraHalfExtents;
-        glm::vec3 cameraMax = point + cameraHalfExtents;
-        glm::vec3 colliderMin = collider.center - collider.halfExtents;
-        glm::vec3 colliderMax = collider.center + collider.halfExtents;
+    // Широкая фаза даёт пары по расширенным боксам, поэтому вход проверяется точно
+    void addTriggerContact(const TriggerVolume& volume, const DynamicBody& body) {
+        AABB box = AABB::fromCenter(volume.transform->position, volume.trigger->halfExtents);
+        AABB bodyBox = AABB::fromCenter(body.transform->position, body.collider->halfExtents);
+        if (!box.overlaps(bodyBox)) return;
+        Contact contact{ volume.entity, body.entity };
+        measureContact(box, bodyBox, contact);
+        triggerContacts.add(0, contact);
+    }
+
+    // Контакт пары записывается от тела с меньшим EntityID, чтобы ключ не зависел от порядка в паре
+    void addDynamicContact(const DynamicBody& a, const DynamicBody& b) {
+        if (a.physics->sleeping && b.physics->sleeping) return;
+        const DynamicBody& first = a.entity < b.entity ? a : b;
+        const DynamicBody& second = a.entity < b.entity ? b : a;
+        AABB box = AABB::fromCenter(first.transform->position, first.collider->halfExtents);
+        AABB otherBox = AABB::fromCenter(second.transform->position, second.collider->halfExtents);
+        if (!box.expanded(contactMargin).overlaps(otherBox)) return;
+        Contact contact{ first.entity, second.entity };
+        measureContact(otherBox, box, contact);
+        contacts.add(0, contact);
+    }
+
+    // Нормаль - по оси наименьшего перекрытия от other к box; при зазоре перекрытие
+    // отрицательно и выбирается ось зазора
+    static void measureContact(const AABB& other, const AABB& box, Contact& contact) {
+        glm::vec3 overlap = glm::min(box.max, other.max) - glm::max(box.min, other.min);
+        int axis = overlap.x < overlap.y ? (overlap.x < overlap.z ? 0 : 2) : (overlap.y < overlap.z ? 1 : 2);
+        contact.normal = glm::vec3(0.0f);
+        contact.normal[axis] = box.center()[axis] >= other.center()[axis] ? 1.0f : -1.0f;
+        contact.depth = std::max(overlap[axis], 0.0f);
+    }
+
+    // Спящее тело будит движущийся сосед, касающийся его или стоящий вплотную, так что
+    // пробуждение расходится по стопке; соседа в покое спящее тело держит как статика
+    void wakeTouching(EntityManager& manager, const DynamicBody& a, const DynamicBody& b) {
+        if (a.physics->sleeping == b.physics->sleeping) return;
+        AABB boxA = AABB::fromCenter(a.transform->position, a.collider->halfExtents);
+        AABB boxB = AABB::fromCenter(b.transform->position, b.collider->halfExtents);
+        if (!boxA.expanded(contactMargin).overlaps(boxB)) return;
+        if (a.physics->sleeping && b.physics->restingFrames == 0) manager.getComponent<PhysicsComponent>(a.entity).wake();
+        if (b.physics->sleeping && a.physics->restingFrames == 0) manager.getComponent<PhysicsComponent>(b.entity).wake();
+    }
+
+    // Контакты кадра со статикой и между телами решаются вместе, так что вес
+    // стопки доходит до опоры. Контроллер движется по земле сам: его скорость по земле
+    // входит в скорость тела, а изменение по горизонтали возвращается в groundVelocity
+    void solveContacts(EntityManager& manager, float deltaTime) {
+        solver.beginFrame(dynamicBodies.size());
+        for (uint32_t index = 0; index < dynamicBodies.size(); ++index) {
+            const DynamicBody& body = dynamicBodies[index];
+            SolverBody& solverBody = solver.body(index);
+            solverBody.velocity = body.physics->velocity;
+            if (body.movement) {
+                solverBody.velocity += body.movement->groundVelocity;
+                solverBody.friction = false;
+            }
+            solverBody.inverseMass = body.physics->mass > 0.0f && !body.physics->sleeping ? 1.0f / body.physics->mass : 0.0f;
+        }
 
-        bool collision = (cameraMin.x <= colliderMax.x && cameraMax.x >= colliderMin.x) &&
-            (cameraMin.y <= colliderMax.y && cameraMax.y >= colliderMin.y) &&
-            (cameraMin.z <= colliderMax.z && cameraMax.z >= colliderMin.z);
+        contacts.eachAdded([&](Contact& contact) {
+            uint32_t index = dynamicProxies[entityIndex(contact.entity)].body;
+            const DynamicBody& body = dynamicBodies[index];
+            AABB box = AABB::fromCenter(body.transform->position, body.collider->halfExtents);
+            uint32_t other = ContactSolver::staticBody;
+            AABB otherBox = contact.isStatic() ? staticColliders[contact.staticCollider].bounds() : AABB{};
+            if (!contact.isStatic()) {
+                other = dynamicProxies[entityIndex(contact.other)].body;
+                otherBox = AABB::fromCenter(dynamicBodies[other].transform->position, dynamicBodies[other].collider->halfExtents);
+            }
+            // Боксы, соседние только ребром или углом, не давят друг на друга; ребро
+            // считается и у боксов, вдавленных друг в друга меньше чем на contactMargin
+            glm::vec3 overlap = glm::min(box.max, otherBox.max) - glm::max(box.min, otherBox.min);
+            int axis = contact.normal.x != 0.0f ? 0 : (contact.normal.y != 0.0f ? 1 : 2);
+            if (overlap[(axis + 1) % 3] <= contactMargin || overlap[(axis + 2) % 3] <= contactMargin) return;
+            // Нормаль смотрит на entity: вверх - entity стоит на статике или другом теле,
+            // вниз - другое тело стоит на entity
+            const DynamicBody* upper = contact.normal.y > 0.5f ? &body
+                : (!contact.isStatic() && contact.normal.y < -0.5f ? &dynamicBodies[other] : nullptr);
+            if (upper && !upper->physics->onGround) manager.getComponent<PhysicsComponent>(upper->entity).onGround = true;
+            const Contact* previous = contacts.find(contact);
+            solver.addContact(contact, index, other, -overlap[axis], previous ? previous->impulse : glm::vec3(0.0f));
+        });
+        solver.solve(deltaTime, jobs);
+
+        for (uint32_t index = 0; index < dynamicBodies.size(); ++index) {
+            const DynamicBody& body = dynamicBodies[index];
+            const SolverBody& solverBody = solver.body(index);
+            if (solverBody.inverseMass == 0.0f) continue;
+            glm::vec3 change = solverBody.velocity - body.physics->velocity;
+            if (body.movement) {
+                change -= body.movement->groundVelocity;
+                if (change.x != 0.0f || change.z != 0.0f) {
+                    manager.getComponent<MovementComponent>(body.entity).groundVelocity += glm::vec3(change.x, 0.0f, change.z);
+                }
+                change.x = change.z = 0.0f;
+            }
+            if (change != glm::vec3(0.0f)) manager.getComponent<PhysicsComponent>(body.entity).velocity += change;
+            if (solverBody.shift != glm::vec3(0.0f)) manager.getComponent<TransformComponent>(body.entity).position += solverBody.shift;
+        }
+    }
+
+    // Счёт кадров покоя ведётся после решения контактов, когда движение кадра окончательно:
+    // в покое и скорость, и фактическое смещение, ведь соседи двигают тело, не трогая
+    // его скорость. Засыпает только тело на опоре, иначе оно зависло бы в воздухе
+    void updateSleep(EntityManager& manager, float deltaTime) {
+        for (const auto& body : dynamicBodies) {
+            const PhysicsComponent& physics = *body.physics;
+            DynamicProxy& proxy = dynamicProxies[entityIndex(body.entity)];
+            glm::vec3 displacement = body.transform->position - proxy.endPosition;
+            proxy.endPosition = body.transform->position;
+            if (physics.sleeping || sleepFrames == 0) continue;
 
-        if (collision) {
-            Logger::log("Collision detected: entity at (" + std::to_string(point.x) + ", " + std::to_string(point.y) + ", " +
-                std::to_string(point.z) + "), collider center = (" + std::to_string(collider.center.x) + ", " +
-                std::to_string(collider.center.y) + ", " + std::to_string(collider.center.z) + ")");
+            glm::vec3 velocity = physics.velocity;
+            if (body.movement) velocity += body.movement->groundVelocity;
+            float limit = sleepVelocity * sleepVelocity;
+            if (glm::dot(velocity, velocity) > limit || glm::dot(displacement, displacement) > limit * deltaTime * deltaTime) {
+                if (physics.restingFrames != 0) manager.getComponent<PhysicsComponent>(body.entity).restingFrames = 0;
+                continue;
+            }
+            PhysicsComponent& resting = manager.getComponent<PhysicsComponent>(body.entity);
+            ++resting.restingFrames;
+            if (resting.restingFrames >= sleepFrames && resting.onGround) {
+                resting.sleeping = true;
+                resting.velocity = glm::vec3(0.0f);
+                if (Logger::verbose) Logger::log("Entity " + std::to_string(body.entity) + " fell asleep");
+            }
         }
+    }
 
-        return collision;
+    // Время построения попадает в лог, чтобы следить за загрузкой больших уровней
+    void buildStaticBroadphase() {
+        auto start = std::chrono::steady_clock::now();
+        // BVH нужен запросам лучей при любом выборе, сетка - только если выбрана
+        bvh.build(staticColliders);
+        if (staticBroadphase == StaticBroadphase::HashGrid) grid.build(staticColliders);
+        staticDirty = false;
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        Logger::log("Static broadphase built: " + std::to_string(staticColliders.size()) + " colliders in " +
+            std::to_string(elapsed.count()) + " ms");
     }
 };
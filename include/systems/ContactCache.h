@@ -0,0 +1,139 @@
+#pragma once
+
+#include "core/Entity.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+enum class ContactEventType : uint8_t {
+    Begin,
+    Persist,
+    End
+};
+
+// Контакт тела entity с телом other или, если other == NULL_ENTITY, со статическим
+// коллайдером staticCollider. normal направлена от другого коллайдера к entity,
+// depth - глубина перекрытия, 0 для касания вплотную. impulse - импульс, который
+// контакт передал entity за кадр; по нему решатель прогревается в следующем кадре
+struct Contact {
+    EntityID entity = NULL_ENTITY;
+    EntityID other = NULL_ENTITY;
+    uint32_t staticCollider = 0;
+    glm::vec3 normal = glm::vec3(0.0f);
+    float depth = 0.0f;
+    glm::vec3 impulse = glm::vec3(0.0f);
+
+    bool isStatic() const { return other == NULL_ENTITY; }
+};
+
+struct ContactEvent {
+    ContactEventType type;
+    Contact contact;
+};
+
+// Контакты, сохраняемые между кадрами по паре коллайдеров. За кадр контакты
+// собираются в буферы потоков, а в endFrame сравниваются с прошлым кадром:
+// новая пара даёт Begin, сохранившаяся - Persist, пропавшая - End.
+// Буферы и массив событий очищаются без освобождения памяти
+class ContactCache {
+public:
+    explicit ContactCache(size_t eventCapacity = 1024) {
+        events.reserve(eventCapacity);
+        cache.reserve(eventCapacity);
+    }
+
+    // threads - сколько потоков будет вызывать add в этом кадре
+    void beginFrame(size_t threads) {
+        if (frameContacts.size() < threads) frameContacts.resize(threads);
+        for (auto& contacts : frameContacts) contacts.clear();
+        events.clear();
+        ++frame;
+    }
+
+    // thread - номер потока из [0, threads), каждый поток пишет в свой буфер
+    void add(size_t thread, const Contact& contact) {
+        frameContacts[thread].push_back(contact);
+    }
+
+    // fn(Contact&) для контактов, добавленных в этом кадре; вызывается между add и endFrame
+    template<typename Func>
+    void eachAdded(Func&& fn) {
+        for (auto& contacts : frameContacts) {
+            for (Contact& contact : contacts) fn(contact);
+        }
+    }
+
+    // Контакт той же пары, сохранённый в прошлых кадрах, или nullptr
+    const Contact* find(const Contact& contact) const {
+        auto entry = cache.find(keyOf(contact));
+        return entry != cache.end() ? &entry->second.contact : nullptr;
+    }
+
+    // keep(contact) решает, сохранить ли молча контакт, не найденный в этом кадре:
+    // так контакты спящих тел живут, пока тела не проснутся
+    template<typename Keep>
+    void endFrame(Keep&& keep) {
+        for (const auto& contacts : frameContacts) {
+            for (const Contact& contact : contacts) {
+                auto [entry, inserted] = cache.try_emplace(keyOf(contact));
+                bool repeated = !inserted && entry->second.frame == frame;
+                entry->second.contact = contact;
+                entry->second.frame = frame;
+                if (!repeated) events.push_back(ContactEvent{ inserted ? ContactEventType::Begin : ContactEventType::Persist, contact });
+            }
+        }
+        for (auto entry = cache.begin(); entry != cache.end();) {
+            if (entry->second.frame == frame) {
+                ++entry;
+            }
+            else if (keep(entry->second.contact)) {
+                entry->second.frame = frame;
+                ++entry;
+            }
+            else {
+                events.push_back(ContactEvent{ ContactEventType::End, entry->second.contact });
+                entry = cache.erase(entry);
+            }
+        }
+    }
+
+    // События последнего кадра; действительны до следующего beginFrame
+    const std::vector<ContactEvent>& getEvents() const { return events; }
+    size_t size() const { return cache.size(); }
+
+private:
+    struct Key {
+        EntityID entity;
+        EntityID other;
+        uint32_t staticCollider;
+
+        bool operator==(const Key& key) const {
+            return entity == key.entity && other == key.other && staticCollider == key.staticCollider;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            uint64_t pair = (uint64_t(key.entity) << 32) | (key.other == NULL_ENTITY ? key.staticCollider : key.other);
+            return std::hash<uint64_t>()(pair * 0x9E3779B97F4A7C15ull ^ (key.other == NULL_ENTITY));
+        }
+    };
+
+    struct CachedContact {
+        Contact contact;
+        uint32_t frame = 0;
+    };
+
+    std::unordered_map<Key, CachedContact, KeyHash> cache;
+    std::vector<std::vector<Contact>> frameContacts;
+    std::vector<ContactEvent> events;
+    uint32_t frame = 0;
+
+    // Контакт двух тел записывается с entity < other, так что пара совпадает между кадрами
+    static Key keyOf(const Contact& contact) {
+        return Key{ contact.entity, contact.other, contact.isStatic() ? contact.staticCollider : 0 };
+    }
+};
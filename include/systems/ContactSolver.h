@@ -0,0 +1,306 @@
+#pragma once
+
+#include "core/JobSystem.h"
+#include "systems/ContactCache.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Тело в решателе. inverseMass == 0 - контакты тело не двигают (спящее или без массы);
+// friction == false - трение на тело не действует, его скольжением управляет контроллер.
+// shift - сдвиг позиции, найденный решателем
+struct SolverBody {
+    glm::vec3 velocity = glm::vec3(0.0f);
+    float inverseMass = 0.0f;
+    bool friction = true;
+    glm::vec3 shift = glm::vec3(0.0f);
+};
+
+// Последовательные импульсы для контактов боксов без вращения. Нормаль контакта лежит
+// на оси, так что связь - это импульс вдоль одной оси и трение по двум другим.
+// Связи раскрашиваются так, что в одном цвете нет двух связей с общим подвижным телом:
+// связи цвета решаются параллельно, цвета - по очереди. Итоговый импульс пишется
+// в contact.impulse и в следующем кадре прогревает решение, поэтому высокая стопка
+// держится за несколько итераций, а не сходится заново каждый кадр
+class ContactSolver {
+public:
+    // other для контакта со статикой
+    static constexpr uint32_t staticBody = ~0u;
+
+    void setIterations(int velocity, int position) {
+        velocityIterations = std::max(velocity, 1);
+        positionIterations = std::max(position, 0);
+    }
+
+    void setFriction(float coefficient) {
+        friction = std::max(coefficient, 0.0f);
+    }
+
+    void beginFrame(size_t bodyCount) {
+        bodies.assign(bodyCount, SolverBody{});
+        constraints.clear();
+        colourStarts.clear();
+    }
+
+    SolverBody& body(uint32_t index) { return bodies[index]; }
+
+    // separation - зазор вдоль нормали, отрицательный при перекрытии; warmImpulse -
+    // импульс пары в прошлом кадре. Контакт должен жить до конца solve
+    void addContact(Contact& contact, uint32_t body, uint32_t other, float separation, const glm::vec3& warmImpulse) {
+        Constraint constraint;
+        constraint.contact = &contact;
+        constraint.body = body;
+        constraint.other = other;
+        constraint.axis = contact.normal.x != 0.0f ? 0 : (contact.normal.y != 0.0f ? 1 : 2);
+        constraint.sign = contact.normal[constraint.axis];
+        constraint.separation = separation;
+        constraint.warmImpulse = warmImpulse;
+        constraints.push_back(constraint);
+    }
+
+    // Скорости к началу solve уже сдвинули тела на velocity * deltaTime. Решатель
+    // исправляет скорости и возвращает в shift поправку, после которой позиция такая,
+    // будто шаг сделан уже исправленной скоростью; перекрытия сверх linearSlop
+    // выталкиваются отдельно и скорость не меняют
+    void solve(float deltaTime, JobSystem* jobs) {
+        if (constraints.empty() || deltaTime <= 0.0f) return;
+        // Порядок из буферов потоков случаен, а от него зависит раскраска
+        sortByPair();
+        initialVelocities.resize(bodies.size());
+        for (size_t i = 0; i < bodies.size(); ++i) initialVelocities[i] = bodies[i].velocity;
+
+        for (Constraint& constraint : constraints) prepare(constraint, deltaTime);
+        colour();
+
+        for (int iteration = 0; iteration < velocityIterations; ++iteration) {
+            forEachBatch(jobs, [&](Constraint& constraint) { solveVelocity(constraint); });
+        }
+
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            bodies[i].shift = (bodies[i].velocity - initialVelocities[i]) * deltaTime;
+        }
+        // Движение в статику уже остановлено заметанием, так что сдвиг от статики прочь
+        // вернул бы тело, которое и так стоит на месте
+        for (const Constraint& constraint : constraints) {
+            if (constraint.other != staticBody) continue;
+            float& shift = bodies[constraint.body].shift[constraint.axis];
+            if (shift * constraint.sign > 0.0f) shift = 0.0f;
+        }
+        for (int iteration = 0; iteration < positionIterations; ++iteration) {
+            forEachBatch(jobs, [&](Constraint& constraint) { solvePosition(constraint); });
+        }
+
+        for (const Constraint& constraint : constraints) {
+            glm::vec3 impulse(0.0f);
+            impulse[constraint.axis] = constraint.sign * constraint.normalImpulse;
+            impulse[(constraint.axis + 1) % 3] = constraint.tangentImpulse[0];
+            impulse[(constraint.axis + 2) % 3] = constraint.tangentImpulse[1];
+            constraint.contact->impulse = impulse;
+        }
+    }
+
+    size_t constraintCount() const { return constraints.size(); }
+    // Сколько цветов понадобилось в последнем solve, считая группу связей без цвета
+    size_t colourCount() const {
+        size_t used = 0;
+        for (size_t c = 1; c < colourStarts.size(); ++c) used += colourStarts[c] > colourStarts[c - 1];
+        return used;
+    }
+
+private:
+    // Цвета, на которые хватает маски тела; связи сверх них решаются одним потоком
+    static constexpr uint32_t maxColours = 32;
+    static constexpr size_t constraintsPerJob = 64;
+    // Зазор меньше speculativeSlop считается касанием, перекрытие меньше linearSlop
+    // не выталкивается: иначе тело в покое дрожало бы на границе
+    static constexpr float speculativeSlop = 0.002f;
+    static constexpr float linearSlop = 0.005f;
+    // Доля перекрытия, убираемая за итерацию выталкивания
+    static constexpr float positionCorrection = 0.2f;
+
+    struct SortKey {
+        uint64_t pair;
+        uint32_t staticCollider;
+        uint32_t index;
+
+        bool operator<(const SortKey& key) const {
+            return pair != key.pair ? pair < key.pair : staticCollider < key.staticCollider;
+        }
+    };
+
+    struct Constraint {
+        Contact* contact = nullptr;
+        uint32_t body = 0;
+        uint32_t other = staticBody;
+        int axis = 0;
+        float sign = 1.0f;
+        float separation = 0.0f;
+        glm::vec3 warmImpulse = glm::vec3(0.0f);
+        // Скорость сближения, которую связь допускает: зазор закрывается за шаг
+        float targetVelocity = 0.0f;
+        float mass = 0.0f;
+        bool friction = false;
+        float normalImpulse = 0.0f;
+        float tangentImpulse[2] = { 0.0f, 0.0f };
+        uint32_t colour = 0;
+    };
+
+    std::vector<SolverBody> bodies;
+    std::vector<Constraint> constraints;
+    std::vector<Constraint> coloured;
+    std::vector<SortKey> sortKeys;
+    std::vector<glm::vec3> initialVelocities;
+    std::vector<uint32_t> bodyColours;
+    // Связи цвета c лежат в constraints[colourStarts[c], colourStarts[c + 1])
+    std::vector<size_t> colourStarts;
+    // Следующая свободная позиция каждого цвета при раскладке
+    std::vector<size_t> colourNext;
+    int velocityIterations = 8;
+    int positionIterations = 3;
+    float friction = 0.5f;
+
+    float inverseMassOf(uint32_t index) const {
+        return index == staticBody ? 0.0f : bodies[index].inverseMass;
+    }
+
+    // Эффективная масса и прогрев: импульс прошлого кадра сразу прикладывается к телам
+    void prepare(Constraint& constraint, float deltaTime) {
+        float inverseSum = inverseMassOf(constraint.body) + inverseMassOf(constraint.other);
+        constraint.mass = inverseSum > 0.0f ? 1.0f / inverseSum : 0.0f;
+        if (constraint.mass == 0.0f) return;
+
+        const SolverBody& body = bodies[constraint.body];
+        bool isStatic = constraint.other == staticBody;
+        constraint.friction = friction > 0.0f && body.friction && (isStatic || bodies[constraint.other].friction);
+        // Тела уже сдвинуты скоростью, так что зазор начала шага - это нынешний плюс
+        // пройденное сближение. Статика остановила тело сама, её зазор уже итоговый
+        float gap = constraint.separation;
+        if (!isStatic) {
+            glm::vec3 approach = initialVelocities[constraint.body] - initialVelocities[constraint.other];
+            gap -= approach[constraint.axis] * constraint.sign * deltaTime;
+        }
+        constraint.targetVelocity = -std::max(gap - speculativeSlop, 0.0f) / deltaTime;
+
+        constraint.normalImpulse = std::max(constraint.warmImpulse[constraint.axis] * constraint.sign, 0.0f);
+        float limit = friction * constraint.normalImpulse;
+        for (int k = 0; k < 2; ++k) {
+            constraint.tangentImpulse[k] = constraint.friction ?
+                std::clamp(constraint.warmImpulse[(constraint.axis + 1 + k) % 3], -limit, limit) : 0.0f;
+        }
+        glm::vec3 impulse(0.0f);
+        impulse[constraint.axis] = constraint.sign * constraint.normalImpulse;
+        impulse[(constraint.axis + 1) % 3] = constraint.tangentImpulse[0];
+        impulse[(constraint.axis + 2) % 3] = constraint.tangentImpulse[1];
+        applyImpulse(constraint, impulse);
+    }
+
+    void sortByPair() {
+        sortKeys.resize(constraints.size());
+        for (uint32_t i = 0; i < constraints.size(); ++i) {
+            const Contact& contact = *constraints[i].contact;
+            sortKeys[i] = SortKey{ (uint64_t(contact.entity) << 32) | contact.other, contact.isStatic() ? contact.staticCollider : 0, i };
+        }
+        std::sort(sortKeys.begin(), sortKeys.end());
+        coloured.resize(constraints.size());
+        for (size_t i = 0; i < sortKeys.size(); ++i) coloured[i] = constraints[sortKeys[i].index];
+        constraints.swap(coloured);
+    }
+
+    // Жадная раскраска: связь получает наименьший цвет, не занятый её подвижными телами
+    void colour() {
+        bodyColours.assign(bodies.size(), 0);
+        colourStarts.assign(maxColours + 2, 0);
+        for (Constraint& constraint : constraints) {
+            bool movesBody = inverseMassOf(constraint.body) > 0.0f;
+            bool movesOther = inverseMassOf(constraint.other) > 0.0f;
+            uint32_t used = (movesBody ? bodyColours[constraint.body] : 0u) | (movesOther ? bodyColours[constraint.other] : 0u);
+            uint32_t colour = 0;
+            while (colour < maxColours && (used & (1u << colour))) ++colour;
+            constraint.colour = colour;
+            if (colour < maxColours) {
+                if (movesBody) bodyColours[constraint.body] |= 1u << colour;
+                if (movesOther) bodyColours[constraint.other] |= 1u << colour;
+            }
+            ++colourStarts[colour + 1];
+        }
+        for (size_t c = 1; c < colourStarts.size(); ++c) colourStarts[c] += colourStarts[c - 1];
+
+        // Раскладка по цветам сохраняет порядок внутри цвета
+        coloured.resize(constraints.size());
+        colourNext.assign(colourStarts.begin(), colourStarts.end() - 1);
+        for (const Constraint& constraint : constraints) coloured[colourNext[constraint.colour]++] = constraint;
+        constraints.swap(coloured);
+    }
+
+    template<typename Func>
+    void forEachBatch(JobSystem* jobs, Func&& fn) {
+        for (uint32_t colour = 0; colour <= maxColours; ++colour) {
+            size_t first = colourStarts[colour];
+            size_t count = colourStarts[colour + 1] - first;
+            auto run = [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) fn(constraints[first + i]);
+            };
+            // Последняя группа - связи без цвета, их тела могут повторяться
+            if (jobs && colour < maxColours) jobs->parallelFor(count, constraintsPerJob, run);
+            else run(0, count);
+        }
+    }
+
+    glm::vec3 relativeVelocity(const Constraint& constraint) const {
+        glm::vec3 velocity = bodies[constraint.body].velocity;
+        if (constraint.other != staticBody) velocity -= bodies[constraint.other].velocity;
+        return velocity;
+    }
+
+    // Тела без массы не пишутся: их могут одновременно читать связи того же цвета
+    void applyImpulse(const Constraint& constraint, const glm::vec3& impulse) {
+        SolverBody& body = bodies[constraint.body];
+        if (body.inverseMass > 0.0f) body.velocity += impulse * body.inverseMass;
+        if (constraint.other != staticBody) {
+            SolverBody& other = bodies[constraint.other];
+            if (other.inverseMass > 0.0f) other.velocity -= impulse * other.inverseMass;
+        }
+    }
+
+    void solveVelocity(Constraint& constraint) {
+        if (constraint.mass == 0.0f) return;
+        int axis = constraint.axis;
+        // Трение ограничено нормальным импульсом прошлой итерации
+        if (constraint.friction) {
+            float limit = friction * constraint.normalImpulse;
+            glm::vec3 velocity = relativeVelocity(constraint);
+            glm::vec3 impulse(0.0f);
+            for (int k = 0; k < 2; ++k) {
+                int tangent = (axis + 1 + k) % 3;
+                float accumulated = std::clamp(constraint.tangentImpulse[k] - velocity[tangent] * constraint.mass, -limit, limit);
+                impulse[tangent] = accumulated - constraint.tangentImpulse[k];
+                constraint.tangentImpulse[k] = accumulated;
+            }
+            applyImpulse(constraint, impulse);
+        }
+
+        float normalVelocity = relativeVelocity(constraint)[axis] * constraint.sign;
+        float accumulated = std::max(constraint.normalImpulse + (constraint.targetVelocity - normalVelocity) * constraint.mass, 0.0f);
+        glm::vec3 impulse(0.0f);
+        impulse[axis] = (accumulated - constraint.normalImpulse) * constraint.sign;
+        constraint.normalImpulse = accumulated;
+        applyImpulse(constraint, impulse);
+    }
+
+    // Выталкивание сдвигает только позиции, чтобы исправление перекрытия не разгоняло тела
+    void solvePosition(Constraint& constraint) {
+        if (constraint.mass == 0.0f) return;
+        int axis = constraint.axis;
+        SolverBody& body = bodies[constraint.body];
+        float separation = constraint.separation + body.shift[axis] * constraint.sign;
+        SolverBody* other = constraint.other != staticBody ? &bodies[constraint.other] : nullptr;
+        if (other) separation -= other->shift[axis] * constraint.sign;
+        if (separation >= -linearSlop) return;
+
+        float correction = -positionCorrection * (separation + linearSlop) * constraint.mass * constraint.sign;
+        if (body.inverseMass > 0.0f) body.shift[axis] += correction * body.inverseMass;
+        if (other && other->inverseMass > 0.0f) other->shift[axis] -= correction * other->inverseMass;
+    }
+};
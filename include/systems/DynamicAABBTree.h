@@ -0,0 +1,267 @@
+#pragma once
+
+#include "Broadphase.h"
+#include "Collider.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+struct DynamicTreeNode {
+    AABB box;
+    int32_t parent;
+    int32_t child1;
+    int32_t child2;
+    // Высота поддерева, 0 у листа, -1 у свободного узла
+    int32_t height;
+    uint32_t userData;
+    // У внутреннего узла - объединение фильтров листьев поддерева
+    CollisionFilter filter;
+
+    bool isLeaf() const { return child1 == -1; }
+};
+
+// Динамическое дерево AABB для подвижных коллайдеров. Листья хранят расширенные
+// (fat) боксы: пока тело остаётся внутри своего, дерево не меняется. Вышедший
+// лист переставляется заново, а высота поддеревьев выравнивается поворотами.
+// Узлы лежат в одном массиве, освободившиеся переиспользуются через список.
+// Поддеревья, чьи слои не взаимодействуют с запросом, отсекаются без проверки боксов
+class DynamicAABBTree : public IBroadphase {
+public:
+    static constexpr int32_t nullNode = -1;
+    static constexpr size_t MAX_DEPTH = 256;
+
+    explicit DynamicAABBTree(float margin = 0.1f, float displacementFactor = 2.0f)
+        : margin(margin), displacementFactor(displacementFactor) {}
+
+    int32_t createProxy(const AABB& box, uint32_t userData, const CollisionFilter& filter) override {
+        int32_t proxy = allocateNode();
+        nodes[proxy].box = box.expanded(margin);
+        nodes[proxy].userData = userData;
+        nodes[proxy].filter = filter;
+        nodes[proxy].height = 0;
+        insertLeaf(proxy);
+        return proxy;
+    }
+
+    void destroyProxy(int32_t proxy) override {
+        assert(nodes[proxy].isLeaf());
+        removeLeaf(proxy);
+        freeNode(proxy);
+    }
+
+    // Переставляет лист, только если box вышел за расширенный бокс. Новый бокс
+    // вытягивается по смещению за кадр, чтобы быстрые тела переставлялись реже.
+    // Возвращает true, если дерево изменилось
+    bool moveProxy(int32_t proxy, const AABB& box, const glm::vec3& displacement) override {
+        assert(nodes[proxy].isLeaf());
+        if (nodes[proxy].box.contains(box)) return false;
+
+        removeLeaf(proxy);
+        AABB fat = box.expanded(margin);
+        glm::vec3 predicted = displacement * displacementFactor;
+        fat.min += glm::min(predicted, glm::vec3(0.0f));
+        fat.max += glm::max(predicted, glm::vec3(0.0f));
+        nodes[proxy].box = fat;
+        insertLeaf(proxy);
+        return true;
+    }
+
+    // Каждый лист ищет соседей по своему расширенному боксу; пара попадает в
+    // результат один раз - от листа с меньшим userData, поэтому userData должны быть различны
+    void findPairs(std::vector<BroadphasePair>& pairs) override {
+        pairs.clear();
+        for (const auto& node : nodes) {
+            if (node.height != 0) continue;
+            query(node.box, node.filter, [&](uint32_t other) {
+                if (other > node.userData) pairs.emplace_back(node.userData, other);
+            });
+        }
+    }
+
+    uint32_t getUserData(int32_t proxy) const { return nodes[proxy].userData; }
+    const AABB& getFatAABB(int32_t proxy) const { return nodes[proxy].box; }
+    int32_t getHeight() const { return root == nullNode ? 0 : nodes[root].height; }
+
+    // fn(userData) для каждого листа, чей расширенный бокс пересекает box, а фильтр взаимодействует с filter
+    template<typename Func>
+    void query(const AABB& box, const CollisionFilter& filter, Func&& fn) const {
+        if (root == nullNode) return;
+        std::array<int32_t, MAX_DEPTH> stack;
+        size_t top = 0;
+        stack[top++] = root;
+        while (top > 0) {
+            const DynamicTreeNode& node = nodes[stack[--top]];
+            if (!filter.interacts(node.filter) || !node.box.overlaps(box)) continue;
+            if (node.isLeaf()) {
+                fn(node.userData);
+                continue;
+            }
+            assert(top + 2 <= MAX_DEPTH);
+            stack[top++] = node.child1;
+            stack[top++] = node.child2;
+        }
+    }
+
+private:
+    std::vector<DynamicTreeNode> nodes;
+    int32_t root = nullNode;
+    int32_t freeList = nullNode;
+    float margin;
+    float displacementFactor;
+
+    // Свободные узлы связаны через поле parent
+    int32_t allocateNode() {
+        if (freeList == nullNode) {
+            nodes.push_back(DynamicTreeNode{ AABB::empty(), nullNode, nullNode, nullNode, -1, 0, CollisionFilter{} });
+            freeList = static_cast<int32_t>(nodes.size()) - 1;
+        }
+        int32_t node = freeList;
+        freeList = nodes[node].parent;
+        nodes[node] = DynamicTreeNode{ AABB::empty(), nullNode, nullNode, nullNode, 0, 0, CollisionFilter{} };
+        return node;
+    }
+
+    void freeNode(int32_t node) {
+        nodes[node].parent = freeList;
+        nodes[node].height = -1;
+        freeList = node;
+    }
+
+    // Сосед для нового листа выбирается спуском по минимальному приросту площади
+    void insertLeaf(int32_t leaf) {
+        if (root == nullNode) {
+            root = leaf;
+            nodes[root].parent = nullNode;
+            return;
+        }
+
+        AABB leafBox = nodes[leaf].box;
+        int32_t index = root;
+        while (!nodes[index].isLeaf()) {
+            int32_t child1 = nodes[index].child1;
+            int32_t child2 = nodes[index].child2;
+            float area = nodes[index].box.surfaceArea();
+            float combinedArea = AABB::merged(nodes[index].box, leafBox).surfaceArea();
+
+            // Стоимость сделать лист соседом этого узла и стоимость спуска ниже
+            float cost = 2.0f * combinedArea;
+            float inheritanceCost = 2.0f * (combinedArea - area);
+            float cost1 = descendCost(child1, leafBox) + inheritanceCost;
+            float cost2 = descendCost(child2, leafBox) + inheritanceCost;
+            if (cost < cost1 && cost < cost2) break;
+            index = cost1 < cost2 ? child1 : child2;
+        }
+
+        int32_t sibling = index;
+        int32_t oldParent = nodes[sibling].parent;
+        int32_t newParent = allocateNode();
+        nodes[newParent].parent = oldParent;
+        nodes[newParent].box = AABB::merged(leafBox, nodes[sibling].box);
+        nodes[newParent].filter = CollisionFilter::merged(nodes[leaf].filter, nodes[sibling].filter);
+        nodes[newParent].height = nodes[sibling].height + 1;
+        nodes[newParent].child1 = sibling;
+        nodes[newParent].child2 = leaf;
+        nodes[sibling].parent = newParent;
+        nodes[leaf].parent = newParent;
+        if (oldParent != nullNode) {
+            if (nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = newParent;
+            else nodes[oldParent].child2 = newParent;
+        }
+        else {
+            root = newParent;
+        }
+
+        refit(nodes[leaf].parent);
+    }
+
+    float descendCost(int32_t child, const AABB& leafBox) const {
+        float combined = AABB::merged(leafBox, nodes[child].box).surfaceArea();
+        return nodes[child].isLeaf() ? combined : combined - nodes[child].box.surfaceArea();
+    }
+
+    void removeLeaf(int32_t leaf) {
+        if (leaf == root) {
+            root = nullNode;
+            return;
+        }
+
+        int32_t parent = nodes[leaf].parent;
+        int32_t grandParent = nodes[parent].parent;
+        int32_t sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+        if (grandParent != nullNode) {
+            if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+            else nodes[grandParent].child2 = sibling;
+            nodes[sibling].parent = grandParent;
+            freeNode(parent);
+            refit(grandParent);
+        }
+        else {
+            root = sibling;
+            nodes[sibling].parent = nullNode;
+            freeNode(parent);
+        }
+    }
+
+    // Подъём к корню с балансировкой и пересчётом боксов и высот
+    void refit(int32_t index) {
+        while (index != nullNode) {
+            index = balance(index);
+            int32_t child1 = nodes[index].child1;
+            int32_t child2 = nodes[index].child2;
+            nodes[index].height = 1 + std::max(nodes[child1].height, nodes[child2].height);
+            nodes[index].box = AABB::merged(nodes[child1].box, nodes[child2].box);
+            nodes[index].filter = CollisionFilter::merged(nodes[child1].filter, nodes[child2].filter);
+            index = nodes[index].parent;
+        }
+    }
+
+    // Если высоты потомков A отличаются больше чем на 1, более высокий потомок
+    // поднимается на место A. Возвращает узел, оказавшийся на месте A
+    int32_t balance(int32_t iA) {
+        DynamicTreeNode& A = nodes[iA];
+        if (A.isLeaf() || A.height < 2) return iA;
+
+        int32_t iB = A.child1;
+        int32_t iC = A.child2;
+        int32_t heightDifference = nodes[iC].height - nodes[iB].height;
+        if (heightDifference > 1) return rotateUp(iA, iC, iB);
+        if (heightDifference < -1) return rotateUp(iA, iB, iC);
+        return iA;
+    }
+
+    // Потомок iHigh встаёт на место iA, а iA забирает его более низкого потомка
+    int32_t rotateUp(int32_t iA, int32_t iHigh, int32_t iLow) {
+        DynamicTreeNode& A = nodes[iA];
+        DynamicTreeNode& H = nodes[iHigh];
+        int32_t iF = H.child1;
+        int32_t iG = H.child2;
+
+        H.child1 = iA;
+        H.parent = A.parent;
+        A.parent = iHigh;
+        if (H.parent != nullNode) {
+            if (nodes[H.parent].child1 == iA) nodes[H.parent].child1 = iHigh;
+            else nodes[H.parent].child2 = iHigh;
+        }
+        else {
+            root = iHigh;
+        }
+
+        int32_t iKeep = nodes[iF].height > nodes[iG].height ? iF : iG;
+        int32_t iMove = iKeep == iF ? iG : iF;
+        H.child2 = iKeep;
+        if (A.child1 == iHigh) A.child1 = iMove;
+        else A.child2 = iMove;
+        nodes[iMove].parent = iA;
+
+        A.box = AABB::merged(nodes[iLow].box, nodes[iMove].box);
+        H.box = AABB::merged(A.box, nodes[iKeep].box);
+        A.filter = CollisionFilter::merged(nodes[iLow].filter, nodes[iMove].filter);
+        H.filter = CollisionFilter::merged(A.filter, nodes[iKeep].filter);
+        A.height = 1 + std::max(nodes[iLow].height, nodes[iMove].height);
+        H.height = 1 + std::max(A.height, nodes[iKeep].height);
+        return iHigh;
+    }
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "Simd.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+namespace integrator_batch {
+    // Сколько тел собирается в один SoA-блок; кратно ширине AVX2
+    constexpr size_t BLOCK_SIZE = 256;
+
+    // Блок тел в SoA-раскладке. Признаки хранятся масками: 0 или все биты (-1),
+    // так что векторные ядра используют их без сравнений
+    struct Block {
+        alignas(32) float position[3][BLOCK_SIZE];
+        alignas(32) float velocity[3][BLOCK_SIZE];
+        alignas(32) float gravityScale[BLOCK_SIZE];
+        alignas(32) int32_t onGround[BLOCK_SIZE];
+        alignas(32) int32_t sleeping[BLOCK_SIZE];
+        // Выход: тело упало ниже fallThreshold и перенесено в spawnPoint
+        alignas(32) int32_t respawned[BLOCK_SIZE];
+    };
+
+    struct Params {
+        float gravity;
+        float fallMultiplier;
+        float terminalVelocity;
+        float fallThreshold;
+        float deltaTime;
+        glm::vec3 spawnPoint;
+    };
+
+    // Полунеявный Эйлер: сначала скорость, затем положение по новой скорости.
+    // Спящие тела не меняются; упавшие ниже порога переносятся в spawnPoint
+    // с нулевой скоростью и снимаются с опоры. Гравитация усиливается fallMultiplier
+    // при падении и ограничена снизу; опору телу дают контакты CollisionSystem
+    inline void integrateScalar(Block& block, size_t first, size_t count, const Params& params) {
+        for (size_t i = first; i < first + count; ++i) {
+            block.respawned[i] = 0;
+            if (block.sleeping[i]) continue;
+            if (block.position[1][i] < params.fallThreshold) {
+                for (int axis = 0; axis < 3; ++axis) {
+                    block.position[axis][i] = params.spawnPoint[axis];
+                    block.velocity[axis][i] = 0.0f;
+                }
+                block.onGround[i] = 0;
+                block.respawned[i] = -1;
+                continue;
+            }
+            float vy = block.velocity[1][i];
+            float acceleration = params.gravity * (vy < 0.0f ? params.fallMultiplier : 1.0f) * block.gravityScale[i];
+            block.velocity[1][i] = std::max(vy + acceleration * params.deltaTime, params.terminalVelocity);
+            for (int axis = 0; axis < 3; ++axis) {
+                block.position[axis][i] = block.position[axis][i] + block.velocity[axis][i] * params.deltaTime;
+            }
+        }
+    }
+
+    // Та же формула без ветвлений: ветви считаются для всех дорожек и смешиваются по маскам.
+    // Порядок операций повторяет integrateScalar, поэтому результаты совпадают бит в бит
+    inline void integrate(Block& block, size_t count, const Params& params) {
+        assert(count <= BLOCK_SIZE);
+#if defined(XGAME_SIMD_AVX2)
+        constexpr size_t width = 8;
+        const __m256 gravity = _mm256_set1_ps(params.gravity);
+        const __m256 fallMultiplier = _mm256_set1_ps(params.fallMultiplier);
+        const __m256 terminal = _mm256_set1_ps(params.terminalVelocity);
+        const __m256 threshold = _mm256_set1_ps(params.fallThreshold);
+        const __m256 dt = _mm256_set1_ps(params.deltaTime);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        size_t vectorCount = count / width * width;
+        for (size_t i = 0; i < vectorCount; i += width) {
+            __m256 sleeping = _mm256_castsi256_ps(_mm256_load_si256(reinterpret_cast<const __m256i*>(block.sleeping + i)));
+            __m256 fell = _mm256_andnot_ps(sleeping, _mm256_cmp_ps(_mm256_load_ps(block.position[1] + i), threshold, _CMP_LT_OQ));
+            // Обновляются только бодрствующие и не упавшие
+            __m256 moving = _mm256_andnot_ps(_mm256_or_ps(sleeping, fell), _mm256_castsi256_ps(_mm256_set1_epi32(-1)));
+
+            __m256 vy = _mm256_load_ps(block.velocity[1] + i);
+            __m256 multiplier = _mm256_blendv_ps(one, fallMultiplier, _mm256_cmp_ps(vy, zero, _CMP_LT_OQ));
+            __m256 acceleration = _mm256_mul_ps(_mm256_mul_ps(gravity, multiplier), _mm256_load_ps(block.gravityScale + i));
+            __m256 newVy = _mm256_max_ps(_mm256_add_ps(vy, _mm256_mul_ps(acceleration, dt)), terminal);
+
+            for (int axis = 0; axis < 3; ++axis) {
+                __m256 velocity = axis == 1 ? newVy : _mm256_load_ps(block.velocity[axis] + i);
+                __m256 position = _mm256_load_ps(block.position[axis] + i);
+                __m256 moved = _mm256_add_ps(position, _mm256_mul_ps(velocity, dt));
+                __m256 spawn = _mm256_set1_ps(params.spawnPoint[axis]);
+                __m256 oldVelocity = _mm256_load_ps(block.velocity[axis] + i);
+                position = _mm256_blendv_ps(_mm256_blendv_ps(position, spawn, fell), moved, moving);
+                velocity = _mm256_blendv_ps(_mm256_blendv_ps(oldVelocity, zero, fell), velocity, moving);
+                _mm256_store_ps(block.position[axis] + i, position);
+                _mm256_store_ps(block.velocity[axis] + i, velocity);
+            }
+            __m256i fellMask = _mm256_castps_si256(fell);
+            _mm256_store_si256(reinterpret_cast<__m256i*>(block.onGround + i), _mm256_andnot_si256(fellMask,
+                _mm256_load_si256(reinterpret_cast<const __m256i*>(block.onGround + i))));
+            _mm256_store_si256(reinterpret_cast<__m256i*>(block.respawned + i), fellMask);
+        }
+        integrateScalar(block, vectorCount, count - vectorCount, params);
+#elif defined(XGAME_SIMD_SSE2)
+        // В SSE2 нет blendv, смешивание собирается из and/andnot/or
+        auto select = [](__m128 a, __m128 b, __m128 mask) { return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, a)); };
+        constexpr size_t width = 4;
+        const __m128 gravity = _mm_set1_ps(params.gravity);
+        const __m128 fallMultiplier = _mm_set1_ps(params.fallMultiplier);
+        const __m128 terminal = _mm_set1_ps(params.terminalVelocity);
+        const __m128 threshold = _mm_set1_ps(params.fallThreshold);
+        const __m128 dt = _mm_set1_ps(params.deltaTime);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        size_t vectorCount = count / width * width;
+        for (size_t i = 0; i < vectorCount; i += width) {
+            __m128 sleeping = _mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(block.sleeping + i)));
+            __m128 fell = _mm_andnot_ps(sleeping, _mm_cmplt_ps(_mm_load_ps(block.position[1] + i), threshold));
+            __m128 moving = _mm_andnot_ps(_mm_or_ps(sleeping, fell), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+            __m128 vy = _mm_load_ps(block.velocity[1] + i);
+            __m128 multiplier = select(one, fallMultiplier, _mm_cmplt_ps(vy, zero));
+            __m128 acceleration = _mm_mul_ps(_mm_mul_ps(gravity, multiplier), _mm_load_ps(block.gravityScale + i));
+            __m128 newVy = _mm_max_ps(_mm_add_ps(vy, _mm_mul_ps(acceleration, dt)), terminal);
+
+            for (int axis = 0; axis < 3; ++axis) {
+                __m128 velocity = axis == 1 ? newVy : _mm_load_ps(block.velocity[axis] + i);
+                __m128 position = _mm_load_ps(block.position[axis] + i);
+                __m128 moved = _mm_add_ps(position, _mm_mul_ps(velocity, dt));
+                __m128 spawn = _mm_set1_ps(params.spawnPoint[axis]);
+                __m128 oldVelocity = _mm_load_ps(block.velocity[axis] + i);
+                position = select(select(position, spawn, fell), moved, moving);
+                velocity = select(select(oldVelocity, zero, fell), velocity, moving);
+                _mm_store_ps(block.position[axis] + i, position);
+                _mm_store_ps(block.velocity[axis] + i, velocity);
+            }
+            __m128i fellMask = _mm_castps_si128(fell);
+            _mm_store_si128(reinterpret_cast<__m128i*>(block.onGround + i), _mm_andnot_si128(fellMask,
+                _mm_load_si128(reinterpret_cast<const __m128i*>(block.onGround + i))));
+            _mm_store_si128(reinterpret_cast<__m128i*>(block.respawned + i), fellMask);
+        }
+        integrateScalar(block, vectorCount, count - vectorCount, params);
+#else
+        integrateScalar(block, 0, count, params);
+#endif
+    }
+}
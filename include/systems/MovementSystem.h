@@ -15,12 +15,17 @@ public:
     void setMovementDirection(EntityID entity, const glm::vec3& direction) {
         if (manager && manager->hasComponent<MovementComponent>(entity)) {
             manager->getComponent<MovementComponent>(entity).movementDirection = direction;
+            // Команда двигаться будит спящее тело
+            if (glm::length(direction) > 0.0f && manager->hasComponent<PhysicsComponent>(entity)) {
+                manager->getComponent<PhysicsComponent>(entity).wake();
+            }
         }
     }
 
     void jump(EntityID entity) {
         if (manager && manager->hasComponent<PhysicsComponent>(entity) && manager->hasComponent<MovementComponent>(entity)) {
             auto& physics = manager->getComponent<PhysicsComponent>(entity);
+            physics.wake();
             if (physics.onGround) {
                 physics.velocity.y = jumpStrength;
                 physics.onGround = false;
@@ -36,23 +41,33 @@ public:
         manager = &mgr;
     }
 
+    void setJobSystem(JobSystem& jobSystem) {
+        jobs = &jobSystem;
+    }
+
     void update(EntityManager& manager, float deltaTime) {
-        for (auto entity : manager.getEntitiesWith<MovementComponent, TransformComponent>()) {
-            auto& movement = manager.getComponent<MovementComponent>(entity);
-            auto& transform = manager.getComponent<TransformComponent>(entity);
+        // Выборка только читает; скорость записывается через getComponent, только если изменилась,
+        // чтобы стоящий без ввода контроллер не получал такт изменения каждый шаг
+        manager.parallelEach<const MovementComponent, const TransformComponent>(jobs, 256, [&](EntityID entity, const MovementComponent& movement, const TransformComponent&) {
+            // Спящее тело стоит без ввода, его скорость уже погашена
+            auto* physics = std::as_const(manager).tryGetComponent<PhysicsComponent>(entity);
+            if (physics && physics->sleeping) return;
 
+            glm::vec3 groundVelocity = movement.groundVelocity;
             glm::vec3 targetVelocity = movement.movementDirection * movement.movementSpeed;
-            movement.groundVelocity += (targetVelocity - movement.groundVelocity) * movement.acceleration * deltaTime;
+            groundVelocity += (targetVelocity - groundVelocity) * movement.acceleration * deltaTime;
             if (glm::length(movement.movementDirection) < 0.001f) {
-                movement.groundVelocity -= movement.groundVelocity * movement.friction * deltaTime;
-                if (glm::length(movement.groundVelocity) < 0.01f) movement.groundVelocity = glm::vec3(0.0f);
+                groundVelocity -= groundVelocity * movement.friction * deltaTime;
+                if (glm::length(groundVelocity) < 0.01f) groundVelocity = glm::vec3(0.0f);
             }
+            if (groundVelocity != movement.groundVelocity) manager.getComponent<MovementComponent>(entity).groundVelocity = groundVelocity;
 
-            //      CollisionSystem
-        }
+            // Горизонтальное движение будет обработано в CollisionSystem
+        });
     }
 
 private:
     float jumpStrength;
     EntityManager* manager = nullptr;
+    JobSystem* jobs = nullptr;
 };
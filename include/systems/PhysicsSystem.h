@@ -7,6 +7,8 @@
 #include "core/Components.h"
 #include "core/EntityManager.h"
 #include "core/Logger.h"
+#include "systems/IntegratorBatch.h"
+#include <algorithm>
 
 class PhysicsSystem {
 public:
@@ -17,36 +19,64 @@ public:
         this->spawnPoint = spawnPoint;
     }
 
+    // Без системы задач сущности обновляются в текущем потоке
+    void setJobSystem(JobSystem& jobSystem) {
+        jobs = &jobSystem;
+    }
+
+    // Компоненты лежат в пулах по отдельности, поэтому тела идут блоками по BLOCK_SIZE:
+    // блок собирается в SoA, интегрируется векторным ядром и раскладывается обратно
     void update(EntityManager& manager, float deltaTime) {
-        for (auto entity : manager.getEntitiesWith<PhysicsComponent, TransformComponent>()) {
-            auto& physics = manager.getComponent<PhysicsComponent>(entity);
-            auto& transform = manager.getComponent<TransformComponent>(entity);
-
-            //  
-            if (transform.position.y < fallThreshold) {
-                transform.position = spawnPoint;
-                physics.velocity = glm::vec3(0.0f);
-                physics.onGround = false;
-                Logger::log("Entity " + std::to_string(entity) + " fell too far! Respawned at (" +
-                    std::to_string(spawnPoint.x) + ", " + std::to_string(spawnPoint.y) + ", " +
-                    std::to_string(spawnPoint.z) + ")");
-                continue;
-            }
+        using namespace integrator_batch;
+        const Params params{ gravity, fallMultiplier, terminalVelocity, fallThreshold, deltaTime, spawnPoint };
+        // Сборка только читает: такт изменения ставится при записи, и только проснувшимся телам
+        auto selection = manager.view<const PhysicsComponent, const TransformComponent>();
 
-            //  
-            if (!physics.onGround) {
-                float gravityForce = gravity * (physics.velocity.y < 0.0f ? fallMultiplier : 1.0f);
-                physics.velocity.y += gravityForce * deltaTime;
-                if (physics.velocity.y < terminalVelocity) physics.velocity.y = terminalVelocity;
-                Logger::log("Entity " + std::to_string(entity) + " applying gravity: velocityY = " + std::to_string(physics.velocity.y));
-            }
-            else {
-                physics.velocity.y = 0.0f;
-            }
+        auto integrateRange = [&](size_t begin, size_t end) {
+            Block block;
+            EntityID entities[BLOCK_SIZE];
+            for (size_t first = begin; first < end; first += BLOCK_SIZE) {
+                size_t count = 0;
+                selection.each(first, std::min(first + BLOCK_SIZE, end), [&](EntityID entity, const PhysicsComponent& physics, const TransformComponent& transform) {
+                    entities[count] = entity;
+                    for (int axis = 0; axis < 3; ++axis) {
+                        block.position[axis][count] = transform.position[axis];
+                        block.velocity[axis][count] = physics.velocity[axis];
+                    }
+                    block.gravityScale[count] = physics.gravityMultiplier;
+                    block.onGround[count] = physics.onGround ? -1 : 0;
+                    block.sleeping[count] = physics.sleeping ? -1 : 0;
+                    ++count;
+                });
+                integrate(block, count, params);
 
-            //    
-            transform.position.y += physics.velocity.y * deltaTime;
-        }
+                for (size_t i = 0; i < count; ++i) {
+                    if (block.sleeping[i]) continue;
+                    // Такт ставится только при записи, поэтому тело, которое шаг не сдвинул
+                    // (без скорости и гравитации), остаётся неизменённым
+                    const EntityManager& state = manager;
+                    glm::vec3 position(block.position[0][i], block.position[1][i], block.position[2][i]);
+                    glm::vec3 velocity(block.velocity[0][i], block.velocity[1][i], block.velocity[2][i]);
+                    bool onGround = block.onGround[i] != 0;
+                    if (position != state.getComponent<TransformComponent>(entities[i]).position) {
+                        manager.getComponent<TransformComponent>(entities[i]).position = position;
+                    }
+                    const PhysicsComponent& current = state.getComponent<PhysicsComponent>(entities[i]);
+                    if (velocity != current.velocity || onGround != current.onGround) {
+                        auto& physics = manager.getComponent<PhysicsComponent>(entities[i]);
+                        physics.velocity = velocity;
+                        physics.onGround = onGround;
+                    }
+                    if (block.respawned[i]) {
+                        Logger::log("Entity " + std::to_string(entities[i]) + " fell too far! Respawned at (" +
+                            std::to_string(spawnPoint.x) + ", " + std::to_string(spawnPoint.y) + ", " +
+                            std::to_string(spawnPoint.z) + ")");
+                    }
+                }
+            }
+        };
+        if (jobs) jobs->parallelFor(selection.sizeHint(), BLOCK_SIZE, integrateRange);
+        else integrateRange(0, selection.sizeHint());
     }
 
 private:
@@ -55,4 +85,5 @@ private:
     float fallThreshold;
     float fallMultiplier;
     glm::vec3 spawnPoint = glm::vec3(0.0f, 2.0f, 0.0f);
+    JobSystem* jobs = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+
+// Набор инструкций пакетных ядер выбирается при компиляции: AVX2 при -mavx2 или
+// /arch:AVX2 (опция XGAME_AVX2 в CMake), иначе SSE2, который есть на любом x64;
+// на прочих платформах ядра откатываются на скалярный код
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define XGAME_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XGAME_SIMD_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "AABBBatch.h"
+#include "Collider.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Равномерная сетка статических коллайдеров. Ячейки адресуются хешем целых
+// координат, поэтому пустое пространство уровня память не занимает.
+// Коллайдер заносится во все ячейки, которые задевает его AABB
+class SpatialHashGrid {
+public:
+    explicit SpatialHashGrid(float cellSize = 4.0f) {
+        setCellSize(cellSize);
+    }
+
+    // Размер ячейки подбирается под сцену: примерно размер типичного коллайдера.
+    // После смены размера сетку нужно перестроить
+    void setCellSize(float size) {
+        assert(size > 0.0f);
+        cellSize = size;
+        inverseCellSize = 1.0f / size;
+    }
+
+    float getCellSize() const { return cellSize; }
+
+    void build(const std::vector<Collider>& colliders) {
+        cells.clear();
+        entries.clear();
+
+        std::vector<std::pair<uint64_t, uint32_t>> keyed;
+        for (uint32_t index = 0; index < colliders.size(); ++index) {
+            AABB box = colliders[index].bounds();
+            glm::ivec3 lo = cellOf(box.min), hi = cellOf(box.max);
+            for (int x = lo.x; x <= hi.x; ++x)
+                for (int y = lo.y; y <= hi.y; ++y)
+                    for (int z = lo.z; z <= hi.z; ++z)
+                        keyed.emplace_back(cellKey(x, y, z), index);
+        }
+
+        // Записи одной ячейки лежат подряд, в таблице хранится только их диапазон
+        std::sort(keyed.begin(), keyed.end());
+        entries.reserve(keyed.size());
+        cells.reserve(keyed.size());
+        for (size_t i = 0; i < keyed.size(); ++i) {
+            if (i == 0 || keyed[i].first != keyed[i - 1].first) {
+                cells[keyed[i].first] = CellRange{ static_cast<uint32_t>(i), 0 };
+            }
+            ++cells[keyed[i].first].count;
+            entries.push_back(keyed[i].second);
+        }
+
+        // Границы и фильтры продублированы в порядке записей, чтобы ячейка проверялась пакетом
+        entryBounds.resize(entries.size());
+        entryFilters.resize(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) {
+            entryBounds.set(i, colliders[entries[i]].bounds());
+            entryFilters[i] = colliders[entries[i]].filter;
+        }
+    }
+
+    // fn(index) по одному разу для каждого коллайдера, чей AABB пересекает box, а фильтр
+    // взаимодействует с filter. Только читает сетку, поэтому безопасна для одновременных запросов
+    template<typename Func>
+    void query(const AABB& box, const CollisionFilter& filter, Func&& fn) const {
+        glm::ivec3 lo = cellOf(box.min), hi = cellOf(box.max);
+        for (int x = lo.x; x <= hi.x; ++x) {
+            for (int y = lo.y; y <= hi.y; ++y) {
+                for (int z = lo.z; z <= hi.z; ++z) {
+                    auto cell = cells.find(cellKey(x, y, z));
+                    if (cell == cells.end()) continue;
+                    auto accept = [&](size_t i) { return filter.interacts(entryFilters[i]); };
+                    aabb_batch::forEachOverlapFiltered(box, entryBounds, cell->second.begin, cell->second.count, accept, [&](size_t i) {
+                        // Коллайдер из нескольких ячеек сообщается только из той, где начинается пересечение
+                        if (cellOf(glm::max(box.min, entryBounds.get(i).min)) != glm::ivec3(x, y, z)) return;
+                        fn(entries[i]);
+                    });
+                }
+            }
+        }
+    }
+
+private:
+    struct CellRange {
+        uint32_t begin;
+        uint32_t count;
+    };
+
+    float cellSize = 4.0f;
+    float inverseCellSize = 0.25f;
+    std::unordered_map<uint64_t, CellRange> cells;
+    std::vector<uint32_t> entries;
+    AABBSoA entryBounds;
+    std::vector<CollisionFilter> entryFilters;
+
+    glm::ivec3 cellOf(const glm::vec3& point) const {
+        return glm::ivec3(glm::floor(point * inverseCellSize));
+    }
+
+    // По 21 биту на координату: ключи уникальны в пределах миллиона ячеек от начала координат
+    static uint64_t cellKey(int x, int y, int z) {
+        constexpr uint64_t mask = (uint64_t(1) << 21) - 1;
+        return (uint64_t(x) & mask) << 42 | (uint64_t(y) & mask) << 21 | (uint64_t(z) & mask);
+    }
+};
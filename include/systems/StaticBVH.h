@@ -0,0 +1,293 @@
+#pragma once
+
+#include "AABBBatch.h"
+#include "Collider.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+// Узел BVH: 32 байта, по два узла на кэш-линию. Внутренний узел (count == 0)
+// хранит номер левого потомка, правый лежит сразу за ним; лист - диапазон примитивов
+struct alignas(32) BVHNode {
+    glm::vec3 min;
+    uint32_t leftOrFirst;
+    glm::vec3 max;
+    uint32_t count;
+
+    bool isLeaf() const { return count != 0; }
+    AABB bounds() const { return AABB{ min, max }; }
+};
+
+// Иерархия ограничивающих объёмов для неподвижных коллайдеров. Строится один раз
+// по бинированной эвристике площади поверхности (SAH) и хранится плоским массивом
+// узлов в порядке обхода в глубину; примитивы переупорядочены так, что лист - это
+// непрерывный диапазон. У каждого узла есть объединённый фильтр слоёв его поддерева,
+// поэтому запрос с фильтром отсекает поддеревья без подходящих слоёв, не глядя на боксы
+class StaticBVH {
+public:
+    static constexpr size_t BIN_COUNT = 16;
+    static constexpr uint32_t MAX_LEAF_SIZE = 4;
+    static constexpr size_t MAX_DEPTH = 64;
+    static constexpr size_t PACKET_SIZE = aabb_batch::RAY_PACKET_SIZE;
+
+    void build(const std::vector<Collider>& colliders) {
+        nodes.clear();
+        nodeFilters.clear();
+        leafFilters.clear();
+        leafBounds.resize(0);
+        order.resize(colliders.size());
+        std::iota(order.begin(), order.end(), 0u);
+        primitiveBounds.resize(colliders.size());
+        centroids.resize(colliders.size());
+        for (size_t i = 0; i < colliders.size(); ++i) {
+            primitiveBounds[i] = colliders[i].bounds();
+            centroids[i] = primitiveBounds[i].center();
+        }
+        if (colliders.empty()) return;
+
+        nodes.reserve(2 * colliders.size() - 1);
+        nodes.push_back(BVHNode{});
+        subdivide(0, 0, static_cast<uint32_t>(colliders.size()), 1);
+
+        // Границы в порядке дерева и в SoA: лист проверяется пакетом за несколько инструкций
+        leafBounds.resize(order.size());
+        for (size_t i = 0; i < order.size(); ++i) leafBounds.set(i, primitiveBounds[order[i]]);
+        leafFilters.resize(order.size());
+        for (size_t i = 0; i < order.size(); ++i) leafFilters[i] = colliders[order[i]].filter;
+        // Потомки лежат в массиве после родителя, поэтому фильтры собираются обратным проходом
+        nodeFilters.resize(nodes.size());
+        for (size_t i = nodes.size(); i-- > 0;) {
+            const BVHNode& node = nodes[i];
+            if (node.isLeaf()) {
+                CollisionFilter merged{ 0, 0 };
+                for (uint32_t j = node.leftOrFirst; j < node.leftOrFirst + node.count; ++j) merged = CollisionFilter::merged(merged, leafFilters[j]);
+                nodeFilters[i] = merged;
+            }
+            else {
+                nodeFilters[i] = CollisionFilter::merged(nodeFilters[node.leftOrFirst], nodeFilters[node.leftOrFirst + 1]);
+            }
+        }
+        primitiveBounds.clear();
+        primitiveBounds.shrink_to_fit();
+        centroids.clear();
+        centroids.shrink_to_fit();
+    }
+
+    bool empty() const { return nodes.empty(); }
+    size_t nodeCount() const { return nodes.size(); }
+
+    // fn(index) для каждого коллайдера, чей AABB пересекает box, а фильтр взаимодействует с filter
+    template<typename Func>
+    void query(const AABB& box, const CollisionFilter& filter, Func&& fn) const {
+        if (nodes.empty()) return;
+        std::array<uint32_t, MAX_DEPTH> stack;
+        size_t top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            uint32_t index = stack[--top];
+            const BVHNode& node = nodes[index];
+            if (!filter.interacts(nodeFilters[index]) || !box.overlaps(node.bounds())) continue;
+            if (node.isLeaf()) {
+                aabb_batch::forEachOverlapFiltered(box, leafBounds, node.leftOrFirst, node.count,
+                    [&](size_t i) { return filter.interacts(leafFilters[i]); }, [&](size_t i) { fn(order[i]); });
+                continue;
+            }
+            stack[top++] = node.leftOrFirst + 1;
+            stack[top++] = node.leftOrFirst;
+        }
+    }
+
+    // fn(index, entry) для коллайдеров, в AABB которых луч входит на расстоянии entry <= maxDistance.
+    // fn возвращает новое ограничение расстояния, поэтому поиск ближайшего попадания
+    // отсекает всё, что дальше уже найденного. Ближний потомок обходится первым
+    template<typename Func>
+    void queryRay(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, const CollisionFilter& filter, Func&& fn) const {
+        if (nodes.empty()) return;
+        glm::vec3 inverse = 1.0f / direction;
+        std::array<uint32_t, MAX_DEPTH> stack;
+        size_t top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            uint32_t index = stack[--top];
+            const BVHNode& node = nodes[index];
+            float entry;
+            if (!filter.interacts(nodeFilters[index]) || !rayHits(origin, inverse, node.min, node.max, maxDistance, entry)) continue;
+            if (node.isLeaf()) {
+                for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+                    if (!filter.interacts(leafFilters[i])) continue;
+                    AABB bounds = leafBounds.get(i);
+                    if (rayHits(origin, inverse, bounds.min, bounds.max, maxDistance, entry)) {
+                        maxDistance = fn(order[i], entry);
+                    }
+                }
+                continue;
+            }
+            uint32_t nearChild = node.leftOrFirst, farChild = node.leftOrFirst + 1;
+            float nearEntry, farEntry;
+            bool nearHit = rayHits(origin, inverse, nodes[nearChild].min, nodes[nearChild].max, maxDistance, nearEntry);
+            bool farHit = rayHits(origin, inverse, nodes[farChild].min, nodes[farChild].max, maxDistance, farEntry);
+            if (nearHit && farHit && farEntry < nearEntry) std::swap(nearChild, farChild);
+            if (farHit) stack[top++] = farChild;
+            if (nearHit) stack[top++] = nearChild;
+        }
+    }
+
+    // Пакет из не более чем PACKET_SIZE лучей обходит дерево вместе: узел читается
+    // один раз на пакет и проверяется всеми лучами одной SIMD-проверкой, поддерево
+    // отсекается, только если его не задел ни один. fn(ray, index, entry) возвращает
+    // новое ограничение расстояния для луча ray, итоговые ограничения записываются
+    // в maxDistances. Выгоднее всего для лучей из близких точек в близких направлениях
+    template<typename Func>
+    void queryRayPacket(const glm::vec3* origins, const glm::vec3* directions, float* maxDistances, size_t count,
+        const CollisionFilter& filter, Func&& fn) const {
+        assert(count <= PACKET_SIZE);
+        if (nodes.empty() || count == 0) return;
+        aabb_batch::RayPacket packet;
+        for (size_t ray = 0; ray < PACKET_SIZE; ++ray) {
+            bool used = ray < count;
+            glm::vec3 inverse = used ? 1.0f / directions[ray] : glm::vec3(1.0f);
+            for (int axis = 0; axis < 3; ++axis) {
+                packet.origin[axis][ray] = used ? origins[ray][axis] : 0.0f;
+                packet.inverseDirection[axis][ray] = inverse[axis];
+            }
+            packet.maxDistance[ray] = used ? maxDistances[ray] : -1.0f;
+        }
+
+        float entries[PACKET_SIZE];
+        std::array<uint32_t, MAX_DEPTH> stack;
+        size_t top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            uint32_t index = stack[--top];
+            const BVHNode& node = nodes[index];
+            if (!filter.interacts(nodeFilters[index])) continue;
+            uint32_t active = aabb_batch::rayMask(node.min, node.max, packet, entries);
+            if (!active) continue;
+
+            if (node.isLeaf()) {
+                for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i) {
+                    if (!filter.interacts(leafFilters[i])) continue;
+                    AABB bounds = leafBounds.get(i);
+                    uint32_t hits = aabb_batch::rayMask(bounds.min, bounds.max, packet, entries) & active;
+                    while (hits) {
+                        unsigned ray = aabb_batch::lowestBit(hits);
+                        hits &= hits - 1;
+                        packet.maxDistance[ray] = fn(size_t(ray), order[i], entries[ray]);
+                    }
+                }
+                continue;
+            }
+
+            // Ближним считается потомок со стороны, откуда идёт первый активный луч,
+            // по оси, на которой центры потомков разнесены сильнее всего
+            uint32_t nearChild = node.leftOrFirst, farChild = node.leftOrFirst + 1;
+            glm::vec3 separation = nodes[farChild].bounds().center() - nodes[nearChild].bounds().center();
+            glm::vec3 spread = glm::abs(separation);
+            int axis = spread.x > spread.y ? (spread.x > spread.z ? 0 : 2) : (spread.y > spread.z ? 1 : 2);
+            size_t leader = aabb_batch::lowestBit(active);
+            if (directions[leader][axis] * separation[axis] < 0.0f) std::swap(nearChild, farChild);
+            stack[top++] = farChild;
+            stack[top++] = nearChild;
+        }
+        for (size_t ray = 0; ray < count; ++ray) maxDistances[ray] = packet.maxDistance[ray];
+    }
+
+    // Вход луча в бокс на отрезке [0, maxDistance] (метод пластин)
+    static bool rayHits(const glm::vec3& origin, const glm::vec3& inverseDirection,
+        const glm::vec3& min, const glm::vec3& max, float maxDistance, float& entry) {
+        glm::vec3 t1 = (min - origin) * inverseDirection;
+        glm::vec3 t2 = (max - origin) * inverseDirection;
+        glm::vec3 tNear = glm::min(t1, t2), tFar = glm::max(t1, t2);
+        entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+        float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+        return entry <= exit;
+    }
+
+private:
+    std::vector<BVHNode> nodes;
+    std::vector<uint32_t> order;
+    AABBSoA leafBounds;
+    std::vector<CollisionFilter> leafFilters;
+    std::vector<CollisionFilter> nodeFilters;
+    // Нужны только во время построения
+    std::vector<AABB> primitiveBounds;
+    std::vector<glm::vec3> centroids;
+
+    struct Bin {
+        AABB bounds = AABB::empty();
+        uint32_t count = 0;
+    };
+
+    void subdivide(uint32_t nodeIndex, uint32_t first, uint32_t count, size_t depth) {
+        AABB bounds = AABB::empty();
+        AABB centroidBounds = AABB::empty();
+        for (uint32_t i = first; i < first + count; ++i) {
+            bounds.grow(primitiveBounds[order[i]]);
+            centroidBounds.grow(centroids[order[i]]);
+        }
+        nodes[nodeIndex] = BVHNode{ bounds.min, first, bounds.max, count };
+        if (count <= MAX_LEAF_SIZE || depth >= MAX_DEPTH / 2) return;
+
+        // Центроиды раскладываются по корзинам, разрез выбирается между корзинами
+        int bestAxis = -1;
+        size_t bestSplit = 0;
+        float bestCost = std::numeric_limits<float>::max();
+        for (int axis = 0; axis < 3; ++axis) {
+            float lo = centroidBounds.min[axis], hi = centroidBounds.max[axis];
+            if (hi <= lo) continue;
+            float scale = BIN_COUNT / (hi - lo);
+            std::array<Bin, BIN_COUNT> bins{};
+            for (uint32_t i = first; i < first + count; ++i) {
+                size_t bin = std::min(BIN_COUNT - 1, static_cast<size_t>((centroids[order[i]][axis] - lo) * scale));
+                bins[bin].bounds.grow(primitiveBounds[order[i]]);
+                ++bins[bin].count;
+            }
+
+            // Площади и числа примитивов слева и справа от каждого разреза за один проход
+            std::array<float, BIN_COUNT - 1> leftArea, rightArea;
+            std::array<uint32_t, BIN_COUNT - 1> leftCount, rightCount;
+            AABB leftBox = AABB::empty(), rightBox = AABB::empty();
+            uint32_t leftSum = 0, rightSum = 0;
+            for (size_t i = 0; i < BIN_COUNT - 1; ++i) {
+                leftSum += bins[i].count;
+                leftCount[i] = leftSum;
+                leftBox.grow(bins[i].bounds);
+                leftArea[i] = leftSum ? leftBox.surfaceArea() : 0.0f;
+                rightSum += bins[BIN_COUNT - 1 - i].count;
+                rightCount[BIN_COUNT - 2 - i] = rightSum;
+                rightBox.grow(bins[BIN_COUNT - 1 - i].bounds);
+                rightArea[BIN_COUNT - 2 - i] = rightSum ? rightBox.surfaceArea() : 0.0f;
+            }
+            for (size_t i = 0; i < BIN_COUNT - 1; ++i) {
+                if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+                float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+        if (bestAxis < 0) return;
+        if (bestCost >= count * bounds.surfaceArea() && count <= 4 * MAX_LEAF_SIZE) return;
+
+        float lo = centroidBounds.min[bestAxis];
+        float scale = BIN_COUNT / (centroidBounds.max[bestAxis] - lo);
+        auto middle = std::partition(order.begin() + first, order.begin() + first + count, [&](uint32_t primitive) {
+            return std::min(BIN_COUNT - 1, static_cast<size_t>((centroids[primitive][bestAxis] - lo) * scale)) <= bestSplit;
+        });
+        uint32_t leftSize = static_cast<uint32_t>(middle - order.begin()) - first;
+        if (leftSize == 0 || leftSize == count) return;
+
+        uint32_t left = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(BVHNode{});
+        nodes.push_back(BVHNode{});
+        nodes[nodeIndex].leftOrFirst = left;
+        nodes[nodeIndex].count = 0;
+        subdivide(left, first, leftSize, depth + 1);
+        subdivide(left + 1, first + leftSize, count - leftSize, depth + 1);
+    }
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "Broadphase.h"
+#include "Collider.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Инкрементальный sweep-and-prune. На каждой оси хранится отсортированный массив
+// концов интервалов; между кадрами он досортировывается вставками, что при малых
+// смещениях почти линейно. Каждая перестановка двух концов - это начало или конец
+// перекрытия пары на оси, по ним поддерживается множество пересекающихся пар.
+// Созданные и удалённые прокси тоже применяются в findPairs, пачкой за кадр
+class SweepAndPrune : public IBroadphase {
+public:
+    int32_t createProxy(const AABB& box, uint32_t userData, const CollisionFilter& filter) override {
+        int32_t proxy;
+        if (!freeProxies.empty()) {
+            proxy = freeProxies.back();
+            freeProxies.pop_back();
+        }
+        else {
+            proxy = static_cast<int32_t>(proxies.size());
+            proxies.emplace_back();
+        }
+        // Концы нового прокси вливаются в оси в findPairs, вместе с остальными новыми
+        proxies[proxy] = Proxy{ box, userData, filter, ProxyState::Created, 0, 0 };
+        created.push_back(proxy);
+        return proxy;
+    }
+
+    // Прокси только помечается: концы и пары снимаются в findPairs, там же
+    // освобождается номер, чтобы до этого его не занял новый прокси
+    void destroyProxy(int32_t proxy) override {
+        proxies[proxy].state = ProxyState::Destroyed;
+        destroyed.push_back(proxy);
+    }
+
+    // Только запоминает бокс; оси досортировываются в findPairs одним проходом
+    bool moveProxy(int32_t proxy, const AABB& box, const glm::vec3&) override {
+        proxies[proxy].box = box;
+        return true;
+    }
+
+    void findPairs(std::vector<BroadphasePair>& pairs) override {
+        removeDestroyed();
+        sortAxes();
+        insertCreated();
+        pairs.clear();
+        for (uint64_t key : overlapping) {
+            pairs.emplace_back(proxies[static_cast<uint32_t>(key >> 32)].userData, proxies[static_cast<uint32_t>(key)].userData);
+        }
+    }
+
+private:
+    enum class ProxyState : uint8_t { Live, Created, Destroyed };
+
+    struct Proxy {
+        AABB box;
+        uint32_t userData;
+        CollisionFilter filter;
+        ProxyState state;
+        // Позиции в списках открытых интервалов при поиске пар новых прокси
+        uint32_t activeSlot;
+        uint32_t createdSlot;
+    };
+
+    // id = номер прокси * 2 + признак конца интервала
+    struct Endpoint {
+        float value;
+        uint32_t id;
+    };
+
+    std::vector<Proxy> proxies;
+    std::vector<int32_t> freeProxies;
+    std::array<std::vector<Endpoint>, 3> axes;
+    std::unordered_set<uint64_t> overlapping;
+    // Изменения состава с прошлого findPairs и буферы для их применения
+    std::vector<int32_t> created;
+    std::vector<int32_t> destroyed;
+    std::vector<Endpoint> incoming;
+    std::vector<int32_t> active;
+    std::vector<int32_t> activeCreated;
+
+    static uint32_t endpointId(int32_t proxy, bool isMax) { return static_cast<uint32_t>(proxy) * 2 + (isMax ? 1 : 0); }
+    static int32_t endpointProxy(uint32_t id) { return static_cast<int32_t>(id / 2); }
+    static bool isMax(uint32_t id) { return (id & 1) != 0; }
+
+    static uint64_t pairKey(int32_t a, int32_t b) {
+        if (a > b) std::swap(a, b);
+        return (uint64_t(a) << 32) | uint32_t(b);
+    }
+
+    // При равных значениях начало идёт раньше конца: касающиеся интервалы
+    // перекрываются, как и в AABB::overlaps
+    static bool before(const Endpoint& a, const Endpoint& b) {
+        return a.value < b.value || (a.value == b.value && !isMax(a.id) && isMax(b.id));
+    }
+
+    void sortAxes() {
+        for (int axis = 0; axis < 3; ++axis) {
+            std::vector<Endpoint>& endpoints = axes[axis];
+            for (auto& endpoint : endpoints) {
+                const AABB& box = proxies[endpointProxy(endpoint.id)].box;
+                endpoint.value = isMax(endpoint.id) ? box.max[axis] : box.min[axis];
+            }
+            for (size_t i = 1; i < endpoints.size(); ++i) {
+                Endpoint moving = endpoints[i];
+                size_t j = i;
+                while (j > 0 && before(moving, endpoints[j - 1])) {
+                    swapped(moving, endpoints[j - 1]);
+                    endpoints[j] = endpoints[j - 1];
+                    --j;
+                }
+                endpoints[j] = moving;
+            }
+        }
+    }
+
+    // Концы удалённых прокси вырезаются одним проходом по каждой оси, их пары - одним
+    // проходом по множеству пар
+    void removeDestroyed() {
+        if (destroyed.empty()) return;
+        auto isDestroyed = [this](int32_t proxy) { return proxies[proxy].state == ProxyState::Destroyed; };
+        for (auto& axis : axes) {
+            axis.erase(std::remove_if(axis.begin(), axis.end(),
+                [&](const Endpoint& endpoint) { return isDestroyed(endpointProxy(endpoint.id)); }), axis.end());
+        }
+        for (auto it = overlapping.begin(); it != overlapping.end();) {
+            if (isDestroyed(static_cast<int32_t>(*it >> 32)) || isDestroyed(static_cast<int32_t>(static_cast<uint32_t>(*it)))) it = overlapping.erase(it);
+            else ++it;
+        }
+        created.erase(std::remove_if(created.begin(), created.end(), isDestroyed), created.end());
+        freeProxies.insert(freeProxies.end(), destroyed.begin(), destroyed.end());
+        destroyed.clear();
+    }
+
+    // Концы новых прокси сортируются отдельно и сливаются с каждой осью за O(n + k log k).
+    // Перестановок при слиянии нет, поэтому их пары ищутся одним проходом по оси X:
+    // у каждой пары с новым прокси пересекаются интервалы, и позднее открытый видит
+    // открытый раньше
+    void insertCreated() {
+        if (created.empty()) return;
+        for (int axis = 0; axis < 3; ++axis) {
+            incoming.clear();
+            for (int32_t proxy : created) {
+                incoming.push_back(Endpoint{ proxies[proxy].box.min[axis], endpointId(proxy, false) });
+                incoming.push_back(Endpoint{ proxies[proxy].box.max[axis], endpointId(proxy, true) });
+            }
+            std::sort(incoming.begin(), incoming.end(), before);
+            // Слияние с конца на месте, без временного буфера
+            std::vector<Endpoint>& endpoints = axes[axis];
+            size_t old = endpoints.size(), added = incoming.size();
+            endpoints.resize(old + added);
+            for (size_t write = old + added; added > 0;) {
+                if (old > 0 && before(incoming[added - 1], endpoints[old - 1])) endpoints[--write] = endpoints[--old];
+                else endpoints[--write] = incoming[--added];
+            }
+        }
+
+        active.clear();
+        activeCreated.clear();
+        for (const Endpoint& endpoint : axes[0]) {
+            int32_t proxy = endpointProxy(endpoint.id);
+            bool isCreated = proxies[proxy].state == ProxyState::Created;
+            if (isMax(endpoint.id)) {
+                deactivate(active, &Proxy::activeSlot, proxy);
+                if (isCreated) deactivate(activeCreated, &Proxy::createdSlot, proxy);
+                continue;
+            }
+            // Новый прокси проверяется со всеми открытыми, старый - только с новыми
+            for (int32_t other : isCreated ? active : activeCreated) addIfOverlapping(proxy, other);
+            activate(active, &Proxy::activeSlot, proxy);
+            if (isCreated) activate(activeCreated, &Proxy::createdSlot, proxy);
+        }
+        for (int32_t proxy : created) proxies[proxy].state = ProxyState::Live;
+        created.clear();
+    }
+
+    void activate(std::vector<int32_t>& list, uint32_t Proxy::* slot, int32_t proxy) {
+        proxies[proxy].*slot = static_cast<uint32_t>(list.size());
+        list.push_back(proxy);
+    }
+
+    void deactivate(std::vector<int32_t>& list, uint32_t Proxy::* slot, int32_t proxy) {
+        uint32_t position = proxies[proxy].*slot;
+        list[position] = list.back();
+        proxies[list[position]].*slot = position;
+        list.pop_back();
+    }
+
+    // Слои проверяются первыми, так что несовместимые пары боксы не сравнивают
+    void addIfOverlapping(int32_t a, int32_t b) {
+        if (proxies[a].filter.interacts(proxies[b].filter) && proxies[a].box.overlaps(proxies[b].box)) overlapping.insert(pairKey(a, b));
+    }
+
+    // moving переходит влево через passed. Начало, обогнавшее чужой конец, открывает
+    // перекрытие на оси - пара добавляется, если слои взаимодействуют и боксы пересекаются
+    // целиком. Конец, обогнавший чужое начало, закрывает перекрытие - пара удаляется
+    void swapped(const Endpoint& moving, const Endpoint& passed) {
+        int32_t a = endpointProxy(moving.id), b = endpointProxy(passed.id);
+        if (a == b) return;
+        if (!isMax(moving.id) && isMax(passed.id)) {
+            addIfOverlapping(a, b);
+        }
+        else if (isMax(moving.id) && !isMax(passed.id)) {
+            overlapping.erase(pairKey(a, b));
+        }
+    }
+};
@@ -11,6 +11,10 @@
 #include "core/EntityManager.h"
 #include "core/camera.h"
 #include "core/Logger.h"
+#include "core/EntityCommandBuffer.h"
+#include "core/FixedTimestep.h"
+#include "core/JobSystem.h"
+#include "core/SystemScheduler.h"
 
 #include "systems/CollisionSystem.h"
 #include "systems/MovementSystem.h"
@@ -38,8 +42,8 @@ float lastY = SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 
 // Тайминги
-float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+double deltaTime = 0.0;
+double lastFrame = 0.0;
 
 // Позиции объектов
 glm::vec3 objectPositions[] = {
@@ -69,7 +73,8 @@ public:
     RenderSystem(Shader& shader, unsigned int vao, Texture& diffuse, Texture& specular, Texture& emission)
         : shader(shader), VAO(vao), diffuse(diffuse), specular(specular), emission(emission) {}
 
-    void update(EntityManager& manager, Camera& camera, float aspectRatio) {
+    // alpha - доля шага симуляции, на которую кадр отстоит от последнего состояния
+    void update(EntityManager& manager, Camera& camera, float aspectRatio, float alpha) {
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -99,20 +104,35 @@ public:
         emission.Bind(GL_TEXTURE2);
         shader.setInt("material.emission", 2);
 
-        glBindVertexArray(VAO);
-        for (auto entity : manager.getEntitiesWith<TransformComponent, RenderComponent>()) {
-            auto& transform = manager.getComponent<TransformComponent>(entity);
-            auto& render = manager.getComponent<RenderComponent>(entity);
-
+        // Матрицы пересчитываются только для сущностей, у которых с прошлого кадра
+        // менялись положение или параметры отрисовки
+        uint32_t since = lastTick;
+        lastTick = manager.advanceTick();
+        auto rebuild = [&](EntityID entity, const TransformComponent& transform, const RenderComponent& render) {
+            size_t slot = entityIndex(entity);
+            if (slot >= models.size()) models.resize(slot + 1, glm::mat4(1.0f));
             glm::mat4 model = glm::mat4(1.0f);
             model = glm::translate(model, transform.position);
             if (render.rotationAngle != 0.0f) {
                 model = glm::rotate(model, glm::radians(render.rotationAngle), render.rotationAxis);
             }
-            model = glm::scale(model, render.scale);
-            shader.setMat4("model", model);
+            models[slot] = glm::scale(model, render.scale);
+        };
+        manager.view<const TransformComponent, const RenderComponent>().where(Changed<TransformComponent>{ since }).each(rebuild);
+        manager.view<const TransformComponent, const RenderComponent>().where(Changed<RenderComponent>{ since }).each(rebuild);
+
+        // У интерполируемых сущностей перенос матрицы каждый кадр заменяется
+        // положением между двумя последними шагами симуляции
+        manager.each<const TransformComponent, const PreviousTransformComponent, const RenderComponent>(
+            [&](EntityID entity, const TransformComponent& transform, const PreviousTransformComponent& previous, const RenderComponent&) {
+                models[entityIndex(entity)][3] = glm::vec4(glm::mix(previous.position, transform.position, alpha), 1.0f);
+            });
+
+        glBindVertexArray(VAO);
+        manager.each<const TransformComponent, const RenderComponent>([&](EntityID entity, const TransformComponent&, const RenderComponent&) {
+            shader.setMat4("model", models[entityIndex(entity)]);
             glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
+        });
     }
 
 private:
@@ -121,6 +141,8 @@ private:
     Texture& diffuse;
     Texture& specular;
     Texture& emission;
+    uint32_t lastTick = 0;
+    std::vector<glm::mat4> models;
 };
 
 int main() {
@@ -226,28 +248,36 @@ int main() {
     EntityManager manager;
     PhysicsSystem physics(-20.0f, -30.0f, -100.0f, 1.0f);
     CollisionSystem collisions;
+    // Статические коллайдеры ищутся через BVH; для сетки ячейку берём порядка размера кубов уровня
+    collisions.setCellSize(2.0f);
     MovementSystem movement(8.0f);
     RenderSystem render(cube, VAO, diffuse, specular, emission);
 
+    // Горячий набор компонентов физики и коллизий держим владеющей группой:
+    // физика и коллизии идут по параллельным массивам пулов без проверок.
+    // Вместо группы можно включить чанки архетипа через useArchetype с тем же набором
+    manager.useGroup<TransformComponent, PhysicsComponent, ColliderComponent>();
+
     // Создание игрока
     EntityID player = manager.createEntity();
     manager.addComponent(player, TransformComponent{ glm::vec3(0.0f, 5.0f, -1.0f) });
+    manager.addComponent(player, PreviousTransformComponent{ glm::vec3(0.0f, 5.0f, -1.0f) });
     manager.addComponent(player, PhysicsComponent{});
-    manager.addComponent(player, ColliderComponent{ glm::vec3(0.3f, 0.5f, 0.2f), 0.5f });
+    manager.addComponent(player, ColliderComponent{ glm::vec3(0.3f, 0.5f, 0.2f), 0.5f, CollisionFilter{} });
     manager.addComponent(player, MovementComponent{ glm::vec3(0), camera.MovementSpeed, 3.0f, 3.0f, glm::vec3(0) });
 
     // Создание игровых объектов
     for (size_t i = 0; i < 10; ++i) {
         EntityID obj = manager.createEntity();
         manager.addComponent(obj, TransformComponent{ objectPositions[i] });
-        manager.addComponent(obj, ColliderComponent{ glm::vec3(0.5f), 0.5f });
+        manager.addComponent(obj, ColliderComponent{ glm::vec3(0.5f), 0.5f, CollisionFilter{} });
         manager.addComponent(obj, RenderComponent{ glm::vec3(1.0f)});
         collisions.addStaticCollider(Collider(objectPositions[i], glm::vec3(0.5f)));
     }
     // Пол
     EntityID floor = manager.createEntity();
     manager.addComponent(floor, TransformComponent{ objectPositions[10] });
-    manager.addComponent(floor, ColliderComponent{ glm::vec3(5.0f), 5.0f });
+    manager.addComponent(floor, ColliderComponent{ glm::vec3(5.0f), 5.0f, CollisionFilter{} });
     manager.addComponent(floor, RenderComponent{ glm::vec3(10.0f), 0.0f });
     collisions.addStaticCollider(Collider(objectPositions[10], glm::vec3(10.0f)));
 
@@ -258,6 +288,51 @@ int main() {
     // Связка MovementSystem с EntityManager
     movement.setManager(manager);
 
+    // Системы делят свои выборки между потоками той же системы задач
+    JobSystem jobs;
+    physics.setJobSystem(jobs);
+    movement.setJobSystem(jobs);
+    collisions.setJobSystem(jobs);
+
+    // Структурные изменения из систем копятся по потокам и применяются после кадра
+    EntityCommandBuffers commands(jobs);
+
+    // Симуляция идёт постоянными шагами независимо от частоты кадров
+    FixedTimestep timestep(60.0f, 5);
+
+    // Планировщик шага симуляции. Перед шагом состояние запоминается для интерполяции
+    SystemScheduler scheduler(jobs);
+    scheduler.addSystem("snapshot", Reads<TransformComponent>{}, Writes<PreviousTransformComponent>{},
+        [&](float) {
+            // Запись только у сдвинувшихся, иначе такт изменения получали бы и стоящие сущности
+            manager.each<const TransformComponent, const PreviousTransformComponent>([&](EntityID entity, const TransformComponent& transform, const PreviousTransformComponent& previous) {
+                if (previous.position != transform.position) manager.getComponent<PreviousTransformComponent>(entity).position = transform.position;
+            });
+        });
+    // TransformComponent нужен движению только для отбора сущностей, значения не читаются;
+    // из PhysicsComponent читается признак сна, который физика не меняет. Поэтому движение
+    // зарегистрировано до физики: с запоминанием состояния у него нет общих компонентов,
+    // и эти две системы идут параллельно. Физика и столкновения пишут одно и то же
+    // и идут друг за другом, ускоряясь только за счёт parallelFor внутри себя
+    scheduler.addSystem("movement", Reads<PhysicsComponent>{}, Writes<MovementComponent>{},
+        [&](float dt) { movement.update(manager, dt); });
+    scheduler.addSystem("physics", Reads<>{}, Writes<PhysicsComponent, TransformComponent>{},
+        [&](float dt) { physics.update(manager, dt); });
+    // Решатель контактов возвращает игроку скорость по земле, погашенную столкновением
+    scheduler.addSystem("collisions", Reads<ColliderComponent, TriggerComponent>{}, Writes<TransformComponent, PhysicsComponent, MovementComponent>{},
+        [&](float dt) { collisions.update(manager, dt); });
+    // Рендеринг идёт раз в кадр отдельным планировщиком и обращается к OpenGL,
+    // поэтому выполняется в главном потоке
+    SystemScheduler frameScheduler(jobs);
+    frameScheduler.addSystem("render", Reads<TransformComponent, PreviousTransformComponent, RenderComponent>{}, Writes<>{},
+        [&](float) {
+            float alpha = timestep.getAlpha();
+            const EntityManager& state = manager;
+            camera.Position = glm::mix(state.getComponent<PreviousTransformComponent>(player).position,
+                state.getComponent<TransformComponent>(player).position, alpha);
+            render.update(manager, camera, (float)SCR_WIDTH / (float)SCR_HEIGHT, alpha);
+        }, true);
+
     // Проверка ошибок OpenGL
     GLenum err;
     while ((err = glGetError()) != GL_NO_ERROR) {
@@ -267,24 +342,19 @@ int main() {
     // Цикл рендеринга
     while (!glfwWindowShouldClose(window)) {
         // Время
-        float currentFrame = static_cast<float>(glfwGetTime());
+        double currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
-        deltaTime = glm::min(deltaTime, 0.016f);
         lastFrame = currentFrame;
 
         // Ввод
         processInput(window, movement, player, camera);
 
-        // Обновление систем
-        physics.update(manager, deltaTime);
-        movement.update(manager, deltaTime);
-        collisions.update(manager, deltaTime);
-
-        // Синхронизация камеры
-        camera.Position = manager.getComponent<TransformComponent>(player).position;
-
-        // Рендеринг
-        render.update(manager, camera, (float)SCR_WIDTH / (float)SCR_HEIGHT);
+        // Шаги симуляции за накопленное время, затем синхронизация камеры и рендеринг
+        timestep.advance(deltaTime, [&](float step) {
+            scheduler.run(step);
+            commands.playback(manager);
+        });
+        frameScheduler.run(static_cast<float>(deltaTime));
 
         // Проверка ошибок OpenGL
         while ((err = glGetError()) != GL_NO_ERROR) {
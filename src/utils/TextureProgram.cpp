@@ -4,7 +4,7 @@
 #include <fstream>
 
 Texture::Texture(const std::string& path, bool flip) : textureID(0) {
-    //   
+    // Проверка существования файла
     std::ifstream file(path);
     if (!file.good()) {
         std::cerr << "Texture file not found: " << path << std::endl;
@@ -12,17 +12,17 @@ Texture::Texture(const std::string& path, bool flip) : textureID(0) {
     }
     file.close();
 
-    //  
+    // Генерация текстуры
     glGenTextures(1, &textureID);
     glBindTexture(GL_TEXTURE_2D, textureID);
 
-    //  
+    // Параметры текстуры
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    //  
+    // Загрузка изображения
     stbi_set_flip_vertically_on_load(flip);
     int width, height, nrChannels;
     unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 0);